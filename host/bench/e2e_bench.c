@@ -0,0 +1,405 @@
+// e2e_bench.c
+// End-to-end benchmark: boots the firmware against the shim and drives the state
+// machine with scripted IR key sequences (wake the dark screen, brew now, schedule
+// a brew, an invalid key), running the same loop as main() under virtual time. Virtual time makes
+// every run identical, so the JSON it prints can be diffed against a saved run.
+//
+// Reports:
+// - Duration of every brew stage, from the profile spans (zero with PROFILING_ENABLED=0)
+// - I2C transactions and bytes per screen (the state core 0 is in), LCD and RTC apart
+// - DHT22 and RTC reads per minute in each phase
+// - Latency from the end of a key frame to the first LCD write after it, with percentiles
+// - Average supply current per phase and while the screen is dark, from the shim's current
+//   model (typical figures, not measurements), and the delay from the IR edge that wakes the
+//   screen to the first LCD write
+// - Flash erases and page programs per screen from the persistence store (none may land while
+//   brewing; the run fails if one does), and the state of the store at the end
+//
+// Host build:
+//   args=(-Ihost); for d in src/*/; do args+=("-I$d"); done
+//   gcc -std=gnu11 -O2 "${args[@]}" src/*/*.c host/host_hal.c host/host_devices.c host/bench/e2e_bench.c -o e2e_bench -lm
+//   ./e2e_bench > run.json   # Exit status 1 when a phase does not reach its end
+// Add -DRTC_SQW_PIN=0 to wire the RTC square wave and keep the chip dormant while a brew is scheduled.
+// The firmware's own console output goes to stderr, so stdout holds only the JSON.
+
+#include "host_hal.h"
+#include "pico/stdlib.h"
+#include "internal_operations.h"
+#include "user_interface.h"
+#include "ir_control.h"
+#include "lcd_i2c.h"
+#include "event_loop.h"
+#include "state.h"
+#include "profile.h"
+#include "power.h"
+#include "flash_kv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define DHT_PIN 8
+#define IR_SENSOR_GPIO_PIN 1
+#define RTC_ADDR 0x68
+
+// NEC commands of the remote (key table in ir_control.c)
+#define IR_ADDRESS 0x00
+#define CMD_PLAY  0xA8
+#define CMD_MINUS 0x98
+#define CMD_0     0x68
+#define CMD_1     0x30
+#define CMD_2     0x18
+#define CMD_3     0x7A
+#define CMD_8     0x4A
+#define CMD_9     0x52
+
+#define MAX_PRESSES 10
+#define MAX_FRAMES 64
+#define MAX_BREWS 8
+#define STATE_COUNT (STATE_SCHEDULING + 1)
+#define NO_LATENCY UINT64_MAX
+
+extern State current_state;
+
+// Same order as the State enum
+static const char *state_names[STATE_COUNT] = {
+  "initial_screen", "select_cups", "schedule_or_now", "brewing", "scheduling"
+};
+
+// Same order as BrewStageId in internal_operations.c
+static const char *stage_names[] = {
+  "resources", "start", "heating", "beans", "grinding", "extraction", "release", "finish"
+};
+#define STAGE_COUNT (sizeof(stage_names) / sizeof(stage_names[0]))
+
+// ---------------------------------- Script ---------------------------------- //
+typedef struct {
+  uint8_t command;
+  uint32_t delay_ms; // After the previous press, or the start of the phase
+} press;
+
+// Both count `ms` from the last press (or the start of a phase without presses)
+typedef enum {
+  END_AFTER_MS,   // Runs for `ms`
+  END_AFTER_BREW, // Runs until a brew finishes; fails after `ms`
+  END_AFTER_WAKE, // Runs for `ms`; the first press must wake the dark screen and do nothing else
+} phase_end;
+
+typedef struct {
+  const char *name;
+  press presses[MAX_PRESSES]; // Ends at the first zero delay
+  phase_end end;
+  uint32_t ms;
+} phase;
+
+// Starts on 2025-01-01 at 07:30; the schedule phase books 08:00 the same day.
+// The screen goes dark a minute into "idle" until its press, and again while waiting for the scheduled brew.
+static const phase script[] = {
+  {"idle", {{CMD_PLAY, 10 * 60 * 1000}}, END_AFTER_WAKE, 2000},
+  {"brew_now", {{CMD_PLAY, 1000}, {CMD_3, 1500}, {CMD_1, 1500}}, END_AFTER_BREW, 2 * 60 * 1000},
+  // Today, then 08:00; each digit comes after its prompt
+  {"schedule", {{CMD_PLAY, 2000}, {CMD_2, 1500}, {CMD_2, 1500}, {CMD_MINUS, 2000},
+                {CMD_0, 2000}, {CMD_8, 2000}, {CMD_0, 6000}, {CMD_0, 2000}}, END_AFTER_MS, 8000},
+  {"scheduled_brew", {{0}}, END_AFTER_BREW, 30 * 60 * 1000},
+  {"invalid_key", {{CMD_PLAY, 2000}, {CMD_9, 1500}, {CMD_0, 2500}}, END_AFTER_MS, 3000},
+};
+#define PHASE_COUNT (sizeof(script) / sizeof(script[0]))
+
+// ---------------------------------- Results ---------------------------------- //
+typedef struct {
+  uint32_t visits;
+  uint32_t lcd_transactions;
+  uint32_t lcd_bytes;
+  uint32_t rtc_transactions;
+  uint32_t rtc_bytes;
+  uint32_t flash_erases;
+  uint32_t flash_programs;
+  uint64_t flash_busy_us;
+} screen_traffic;
+
+typedef struct {
+  uint64_t end_us;     // Last edge of the frame
+  uint64_t latency_us; // To the first LCD write after it
+  int phase;
+} key_frame;
+
+typedef struct {
+  int phase;
+  uint16_t cups;
+  uint32_t total_us;
+  uint32_t stage_us[STAGE_COUNT];
+} brew_result;
+
+typedef struct {
+  bool completed;
+  uint64_t duration_us;
+  uint32_t dht_reads;
+  uint32_t rtc_reads;
+  double average_ma;
+} phase_result;
+
+static screen_traffic screens[STATE_COUNT];
+static key_frame frames[MAX_FRAMES];
+static int frame_count = 0;
+static int first_unanswered = 0;
+static brew_result brews[MAX_BREWS];
+static int brew_count = 0;
+static phase_result results[PHASE_COUNT];
+static FILE *report;
+static int current_phase = 0;
+static State seen_state = STATE_INITIAL_SCREEN;
+static uint64_t wake_edge_us = NO_LATENCY;    // First edge of the press that wakes the screen
+static uint64_t wake_latency_us = NO_LATENCY; // From it to the first LCD write
+static host_power_stats dark;                 // Summed over the spells with the screen dark
+
+// Traffic goes to the state core 0 is in when the transaction starts; the display
+// task can flush a screen just after core 0 moved on, so boundaries are approximate
+static void on_i2c(uint8_t addr, size_t len, bool read) {
+  screen_traffic *t = &screens[current_state < STATE_COUNT ? current_state : STATE_INITIAL_SCREEN];
+  if (addr == RTC_ADDR) {
+    t->rtc_transactions++;
+    t->rtc_bytes += len;
+    return;
+  }
+  if (addr != LCD_ADDR) return;
+  t->lcd_transactions++;
+  t->lcd_bytes += len;
+
+  uint64_t now = host_now_us();
+  if (read) return;
+  if (wake_edge_us != NO_LATENCY && wake_latency_us == NO_LATENCY && now >= wake_edge_us) {
+    wake_latency_us = now - wake_edge_us;
+  }
+  while (first_unanswered < frame_count && frames[first_unanswered].end_us <= now) {
+    frames[first_unanswered].latency_us = now - frames[first_unanswered].end_us;
+    first_unanswered++;
+  }
+}
+
+// Stage and brew spans of the brew that just ended (the ring is emptied when one starts)
+static void collect_brew(void) {
+  static profile_record records[PROFILE_RING_SIZE];
+  if (brew_count == MAX_BREWS) return;
+  brew_result *b = &brews[brew_count++];
+  b->phase = current_phase;
+
+  uint32_t n = profile_read(0, records, PROFILE_RING_SIZE);
+  for (uint32_t i = 0; i < n; i++) {
+    if (records[i].span == PROFILE_SPAN_BREW_STAGE && records[i].arg < STAGE_COUNT) {
+      b->stage_us[records[i].arg] += records[i].duration_us;
+    } else if (records[i].span == PROFILE_SPAN_BREW) {
+      b->cups = records[i].arg;
+      b->total_us = records[i].duration_us;
+    }
+  }
+}
+
+static void note_state(void) {
+  if (current_state == seen_state) return;
+  if (seen_state == STATE_BREWING) collect_brew();
+  if (current_state == STATE_BREWING) profile_reset();
+  if (current_state < STATE_COUNT) screens[current_state].visits++;
+  seen_state = current_state;
+}
+
+// ---------------------------------- Runner ---------------------------------- //
+static void add_dark_spell(const host_power_stats *from, const host_power_stats *to) {
+  for (int i = 0; i < HOST_CLOCK_MODES; i++) dark.mode_us[i] += to->mode_us[i] - from->mode_us[i];
+  dark.backlight_us += to->backlight_us - from->backlight_us;
+  dark.dormant_entries += to->dormant_entries - from->dormant_entries;
+}
+
+// Same body as the loop in main(), minus its profile span
+static void loop_once(uint32_t *events) {
+  key_event key;
+  while (key_event_pop(&key)) {
+    handle_key(&key);
+    note_state();
+  }
+  State state = current_state;
+  host_flash_stats flash_before = host_flash_get_stats();
+  manage_state(*events);
+  host_flash_stats flash_after = host_flash_get_stats();
+  screen_traffic *t = &screens[state < STATE_COUNT ? state : STATE_INITIAL_SCREEN];
+  t->flash_erases += flash_after.erases - flash_before.erases;
+  t->flash_programs += flash_after.programs - flash_before.programs;
+  t->flash_busy_us += flash_after.busy_us - flash_before.busy_us;
+  note_state();
+  if (power_is_idle()) {
+    host_power_stats from = host_power_get_stats();
+    *events = power_idle_wait();
+    host_power_stats to = host_power_get_stats();
+    add_dark_spell(&from, &to);
+  } else {
+    *events = event_wait();
+  }
+}
+
+static bool run_phase(const phase *p, uint32_t *events) {
+  uint64_t at = host_now_us();
+  for (int i = 0; i < MAX_PRESSES && p->presses[i].delay_ms; i++) {
+    at += p->presses[i].delay_ms * 1000ull;
+    uint64_t end = host_ir_press_at(at, IR_ADDRESS, p->presses[i].command);
+    if (p->end == END_AFTER_WAKE && i == 0) { // Timed apart: the screen is dark, so nothing is drawn for it
+      wake_edge_us = at;
+    } else if (frame_count < MAX_FRAMES) {
+      frames[frame_count++] = (key_frame) {end, NO_LATENCY, current_phase};
+    }
+  }
+
+  int brews_before = brew_count;
+  uint64_t deadline = at + p->ms * 1000ull;
+  while (host_now_us() < deadline) {
+    loop_once(events);
+    if (p->end == END_AFTER_BREW && brew_count > brews_before) return true;
+  }
+  if (p->end == END_AFTER_WAKE) { // Lit again, and the key did nothing
+    return !power_is_idle() && host_lcd_backlight() && current_state == STATE_INITIAL_SCREEN;
+  }
+  return p->end == END_AFTER_MS;
+}
+
+// ---------------------------------- Report ---------------------------------- //
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest rank
+static uint64_t percentile(const uint64_t *sorted, int n, int pct) {
+  int rank = (pct * n + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static double per_minute(uint32_t count, uint64_t us) {
+  return us ? count * 60e6 / us : 0.0;
+}
+
+static void print_report(uint64_t total_us, bool ok) {
+  fprintf(report, "{\n  \"format\": 3,\n  \"ok\": %s,\n  \"virtual_s\": %.3f,\n", ok ? "true" : "false", total_us / 1e6);
+
+  fprintf(report, "  \"phases\": [\n");
+  for (unsigned i = 0; i < PHASE_COUNT; i++) {
+    const phase_result *r = &results[i];
+    fprintf(report, "    {\"name\": \"%s\", \"completed\": %s, \"duration_ms\": %.1f, "
+           "\"dht_reads\": %u, \"dht_per_min\": %.2f, \"rtc_reads\": %u, \"rtc_per_min\": %.2f, "
+           "\"average_ma\": %.2f, \"key_latency_us\": [",
+           script[i].name, r->completed ? "true" : "false", r->duration_us / 1e3,
+           r->dht_reads, per_minute(r->dht_reads, r->duration_us),
+           r->rtc_reads, per_minute(r->rtc_reads, r->duration_us), r->average_ma);
+    bool first = true;
+    for (int f = 0; f < frame_count; f++) {
+      if (frames[f].phase != (int)i) continue;
+      if (frames[f].latency_us == NO_LATENCY) {
+        fprintf(report, "%snull", first ? "" : ", ");
+      } else {
+        fprintf(report, "%s%llu", first ? "" : ", ", (unsigned long long)frames[f].latency_us);
+      }
+      first = false;
+    }
+    fprintf(report, "]}%s\n", i + 1 < PHASE_COUNT ? "," : "");
+  }
+  fprintf(report, "  ],\n");
+
+  fprintf(report, "  \"brews\": [\n");
+  for (int i = 0; i < brew_count; i++) {
+    const brew_result *b = &brews[i];
+    fprintf(report, "    {\"phase\": \"%s\", \"cups\": %u, \"total_ms\": %.1f, \"stages_ms\": {",
+           script[b->phase].name, b->cups, b->total_us / 1e3);
+    for (unsigned s = 0; s < STAGE_COUNT; s++) {
+      fprintf(report, "%s\"%s\": %.1f", s ? ", " : "", stage_names[s], b->stage_us[s] / 1e3);
+    }
+    fprintf(report, "}}%s\n", i + 1 < brew_count ? "," : "");
+  }
+  fprintf(report, "  ],\n");
+
+  fprintf(report, "  \"screens\": {\n");
+  for (int i = 0; i < STATE_COUNT; i++) {
+    const screen_traffic *t = &screens[i];
+    fprintf(report, "    \"%s\": {\"visits\": %u, \"lcd_transactions\": %u, \"lcd_bytes\": %u, "
+           "\"rtc_transactions\": %u, \"rtc_bytes\": %u, \"flash_erases\": %u, \"flash_programs\": %u, "
+           "\"flash_busy_ms\": %.1f}%s\n",
+           state_names[i], t->visits, t->lcd_transactions, t->lcd_bytes, t->rtc_transactions, t->rtc_bytes,
+           t->flash_erases, t->flash_programs, t->flash_busy_us / 1e3, i + 1 < STATE_COUNT ? "," : "");
+  }
+  fprintf(report, "  },\n");
+
+  flash_kv_stats kv = flash_kv_get_stats();
+  fprintf(report, "  \"flash\": {\"generation\": %u, \"used_bytes\": %u, \"boot_scan_bytes\": %u, "
+         "\"appends\": %u, \"compactions\": %u},\n",
+         kv.generation, kv.used_bytes, kv.boot_scan_bytes, kv.appends, kv.compactions);
+
+  static const host_power_stats zero;
+  power_stats ps = power_get_stats();
+  uint64_t dark_us = 0;
+  for (int i = 0; i < HOST_CLOCK_MODES; i++) dark_us += dark.mode_us[i];
+  fprintf(report, "  \"power\": {\"sqw_wired\": %s, \"idle_entries\": %u, \"dormant_entries\": %u, "
+         "\"sqw_edges\": %u, \"wakes\": %u, \"dark_s\": %.1f, \"dormant_s\": %.1f, \"dark_average_ma\": %.2f, "
+         "\"wake_edge_to_lcd_us\": ", RTC_SQW_PIN >= 0 ? "true" : "false", ps.entries, ps.dormant_entries,
+         ps.sqw_edges, ps.wakes, dark_us / 1e6, dark.mode_us[HOST_CLOCK_DORMANT] / 1e6,
+         host_power_average_ma(&zero, &dark));
+  if (wake_latency_us == NO_LATENCY) {
+    fprintf(report, "null");
+  } else {
+    fprintf(report, "%llu", (unsigned long long)wake_latency_us);
+  }
+  fprintf(report, ", \"firmware_wake_us\": {\"last\": %u, \"max\": %u}},\n",
+         ps.wake_latency_us, ps.max_wake_latency_us);
+
+  uint64_t sorted[MAX_FRAMES];
+  int n = 0;
+  for (int f = 0; f < frame_count; f++) {
+    if (frames[f].latency_us != NO_LATENCY) sorted[n++] = frames[f].latency_us;
+  }
+  qsort(sorted, n, sizeof(sorted[0]), compare_u64);
+  fprintf(report, "  \"key_latency_us\": {\"keys\": %d, \"answered\": %d", frame_count, n);
+  if (n > 0) {
+    fprintf(report, ", \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu",
+           (unsigned long long)percentile(sorted, n, 50), (unsigned long long)percentile(sorted, n, 90),
+           (unsigned long long)percentile(sorted, n, 99), (unsigned long long)sorted[n - 1]);
+  }
+  fprintf(report, "}\n}\n");
+}
+
+int main(void) {
+  report = fdopen(dup(STDOUT_FILENO), "w");
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+
+  host_dht_attach(DHT_PIN);
+  host_ir_attach(IR_SENSOR_GPIO_PIN);
+  host_rtc_set(2025, 1, 1, 7, 30, 0);
+#if RTC_SQW_PIN >= 0
+  host_rtc_attach_sqw(RTC_SQW_PIN);
+#endif
+
+  setup_machine();
+  init_ir_irq_receiver(IR_SENSOR_GPIO_PIN);
+  power_init(IR_SENSOR_GPIO_PIN);
+  host_i2c_set_observer(on_i2c);
+  screens[current_state].visits++;
+
+  uint64_t start = host_now_us();
+  uint32_t events = EVENT_STATE_CHANGE; // Runs the initial state right away
+  bool ok = true;
+  for (current_phase = 0; current_phase < (int)PHASE_COUNT; current_phase++) {
+    phase_result *r = &results[current_phase];
+    uint64_t phase_start = host_now_us();
+    uint32_t dht_before = host_dht_reads();
+    uint32_t rtc_before = host_rtc_reads();
+    host_power_stats power_before = host_power_get_stats();
+
+    r->completed = run_phase(&script[current_phase], &events);
+    r->duration_us = host_now_us() - phase_start;
+    r->dht_reads = host_dht_reads() - dht_before;
+    r->rtc_reads = host_rtc_reads() - rtc_before;
+    host_power_stats power_after = host_power_get_stats();
+    r->average_ma = host_power_average_ma(&power_before, &power_after);
+    ok = ok && r->completed;
+  }
+  host_i2c_set_observer(NULL);
+  const screen_traffic *brewing = &screens[STATE_BREWING];
+  ok = ok && brewing->flash_erases == 0 && brewing->flash_programs == 0;
+
+  print_report(host_now_us() - start, ok);
+  fclose(report);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// fixed_point_bench.c
+// Microbenchmark for the fixed-point sensor mapping: checks that the integer
+// versions give the same results as the former float code at display
+// resolution, then times both per call.
+//
+// Host build (links the firmware modules against the shim, like coffee_host):
+//   args=(-Ihost); for d in src/*/; do args+=("-I$d"); done
+//   gcc -std=gnu11 -O2 "${args[@]}" src/*/*.c host/host_hal.c host/host_devices.c host/bench/fixed_point_bench.c -o fixed_point_bench -lm
+// On the board (PICO_ON_DEVICE) the same file reports SysTick cycles instead of ns.
+
+#include "pico/stdlib.h"
+#include "sensors.h"
+#include "internal_operations.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_BATCH 1000
+#define BENCH_ROUNDS 200
+
+// ---------------------------------- Timebase ---------------------------------- //
+#if PICO_ON_DEVICE
+#include "hardware/structs/systick.h"
+#define BENCH_UNIT "cycles"
+
+static void bench_timer_init(void) {
+  systick_hw->rvr = 0x00FFFFFF;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5; // Processor clock, no interrupt
+}
+
+// SysTick counts down; one batch stays well below the 24-bit wrap
+static uint32_t bench_elapsed(uint32_t start) {
+  return (start - systick_hw->cvr) & 0x00FFFFFF;
+}
+
+static uint32_t bench_start(void) {
+  return systick_hw->cvr;
+}
+#else
+#include <time.h>
+#define BENCH_UNIT "ns"
+
+static void bench_timer_init(void) {}
+
+static uint32_t bench_start(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static uint32_t bench_elapsed(uint32_t start) {
+  return bench_start() - start;
+}
+#endif
+
+// ---------------------------------- Former Float Code ---------------------------------- //
+static float float_desired_temperature(uint16_t raw_value) {
+  float percentage = (raw_value * 100.0) / 4095.0;
+  return 85.0 + ((percentage * 10.0) / 100.0);
+}
+
+static const char *float_temperature_level(float temperature) {
+  if (temperature < 90) return "WARM";
+  else if (temperature < 94) return "HOT";
+  else return "HOT++";
+}
+
+static void float_dht_parse(const uint8_t data[5], float *humidity, float *temp_celsius) {
+  *humidity = (float)((data[0] << 8) + data[1]) / 10;
+  if (*humidity > 100) {
+    *humidity = data[0];
+  }
+  *temp_celsius = (float)(((data[2] & 0x7F) << 8) + data[3]) / 10;
+  if (*temp_celsius > 125) {
+    *temp_celsius = data[2];
+  }
+  if (data[2] & 0x80) {
+    *temp_celsius = -*temp_celsius;
+  }
+}
+
+static float float_fahrenheit(float temp_celsius) {
+  return (temp_celsius * 9 / 5) + 32;
+}
+
+// Heating display steps: 25.0 C upwards in 2.5 C steps while at or below the target
+static int float_heating_steps(float desired_temp) {
+  int steps = 0;
+  for (float t = 25.0; t <= desired_temp; t += 2.5) steps++;
+  return steps;
+}
+
+static int fixed_heating_steps(int16_t desired_temp_x10) {
+  int steps = 0;
+  for (int16_t t = 250; t <= desired_temp_x10; t += 25) steps++;
+  return steps;
+}
+
+// ---------------------------------- Equivalence ---------------------------------- //
+// The float code could print "-0.0" (negative zero frame, -17.8 C in Fahrenheit); integers print "0.0"
+static bool same_tenths(float reference, int16_t value_x10) {
+  char a[16], b[16];
+  snprintf(a, sizeof(a), "%.1f", reference);
+  snprintf(b, sizeof(b), "%.1f", value_x10 / 10.0f);
+  return strcmp(strcmp(a, "-0.0") == 0 ? a + 1 : a, b) == 0;
+}
+
+static int check_equivalence(void) {
+  int mismatches = 0;
+
+  for (uint32_t raw = 0; raw < 4096; raw++) {
+    float reference = float_desired_temperature(raw);
+    int16_t fixed = desired_temperature_from_adc(raw);
+    if (strcmp(float_temperature_level(reference), determine_temperature_level(fixed)) != 0 ||
+        float_heating_steps(reference) != fixed_heating_steps(fixed)) {
+      printf("desired temperature mismatch at raw %u\n", raw);
+      mismatches++;
+    }
+  }
+
+  // Every humidity and temperature word, with a valid checksum
+  for (uint32_t word = 0; word < 0x10000; word++) {
+    uint8_t hi = word >> 8, lo = word & 0xFF;
+    uint8_t frames[2][5] = {{hi, lo, 0x00, 0xF0, 0}, {0x02, 0x26, hi, lo, 0}};
+    for (int f = 0; f < 2; f++) {
+      uint8_t *d = frames[f];
+      d[4] = (d[0] + d[1] + d[2] + d[3]) & 0xFF;
+      float humidity, temp_celsius;
+      dht_reading reading;
+      float_dht_parse(d, &humidity, &temp_celsius);
+      if (!dht_parse(d, &reading) || !same_tenths(humidity, reading.humidity_x10) ||
+          !same_tenths(temp_celsius, reading.temp_x10)) {
+        printf("dht mismatch at %02x %02x %02x %02x\n", d[0], d[1], d[2], d[3]);
+        mismatches++;
+      }
+    }
+  }
+
+  for (int16_t t = -400; t <= 1250; t++) {
+    if (!same_tenths(float_fahrenheit(t / 10.0f), convert_to_fahrenheit(t))) {
+      printf("fahrenheit mismatch at %d\n", t);
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+// ---------------------------------- Timing ---------------------------------- //
+static volatile uint32_t sink;
+
+// Best batch of BENCH_BATCH calls, so preemption and cache misses do not count
+#define BENCH(name, ...)                                        \
+  do {                                                          \
+    uint32_t best = UINT32_MAX;                                 \
+    for (int round = 0; round < BENCH_ROUNDS; round++) {        \
+      uint32_t start = bench_start();                           \
+      for (uint32_t i = 0; i < BENCH_BATCH; i++) {              \
+        __VA_ARGS__;                                            \
+      }                                                         \
+      uint32_t elapsed = bench_elapsed(start);                  \
+      if (elapsed < best) best = elapsed;                       \
+    }                                                           \
+    printf("  %-34s %8.2f %s/call\n", name, (double)best / BENCH_BATCH, BENCH_UNIT); \
+  } while (0)
+
+int main(void) {
+  stdio_init_all();
+  bench_timer_init();
+
+  int mismatches = check_equivalence();
+  printf("equivalence: %d mismatches at display resolution\n", mismatches);
+
+  static const uint8_t frame[5] = {0x02, 0x26, 0x80, 0xE5, 0x8D};
+  printf("per call (best of %d batches of %d):\n", BENCH_ROUNDS, BENCH_BATCH);
+  BENCH("float desired temp + level", {
+    float t = float_desired_temperature((uint16_t)(i & 0xFFF));
+    sink += (uint32_t)(uintptr_t)float_temperature_level(t);
+  });
+  BENCH("fixed desired temp + level", {
+    int16_t t = desired_temperature_from_adc((uint16_t)(i & 0xFFF));
+    sink += (uint32_t)(uintptr_t)determine_temperature_level(t);
+  });
+  BENCH("float dht frame + fahrenheit", {
+    float h, t;
+    float_dht_parse(frame, &h, &t);
+    sink += (uint32_t)float_fahrenheit(t + i) + (uint32_t)h;
+  });
+  BENCH("fixed dht frame + fahrenheit", {
+    dht_reading r;
+    dht_parse(frame, &r);
+    sink += (uint32_t)convert_to_fahrenheit(r.temp_x10 + i) + (uint32_t)r.humidity_x10;
+  });
+  BENCH("float heating steps (95 C)", {
+    sink += float_heating_steps(95.0f - (i & 1));
+  });
+  BENCH("fixed heating steps (95 C)", {
+    sink += fixed_heating_steps(950 - (i & 1) * 10);
+  });
+
+  return mismatches != 0;
+}
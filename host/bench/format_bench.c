@@ -0,0 +1,144 @@
+// format_bench.c
+// Microbenchmark for lcd_format: compares every display field against the
+// snprintf output it replaced, then times both per field.
+//
+// Host build:
+//   args=(-Ihost); for d in src/*/; do args+=("-I$d"); done
+//   gcc -std=gnu11 -O2 "${args[@]}" src/*/*.c host/host_hal.c host/host_devices.c host/bench/format_bench.c -o format_bench -lm
+
+#include "lcd_format.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define BENCH_BATCH 1000
+#define BENCH_ROUNDS 200
+
+static uint32_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+// ---------------------------------- Fields ---------------------------------- //
+static void fixed_ambient(char *out, int16_t temp_x10, int16_t humidity_x10) {
+  char *p = fmt_decimal(out, temp_x10, 1, 1);
+  p = fmt_text(p, "C|H:");
+  p = fmt_decimal(p, humidity_x10, 1, 1);
+  fmt_end(fmt_text(p, "%"));
+}
+
+static void printf_ambient(char *out, int16_t temp_x10, int16_t humidity_x10) {
+  snprintf(out, 32, "%.1fC|H:%.1f%%", temp_x10 / 10.0f, humidity_x10 / 10.0f);
+}
+
+static void fixed_status(char *out, int beans_g, int water_ml) {
+  char *p = fmt_text(out, "B:");
+  p = fmt_int(p, beans_g);
+  p = fmt_text(p, "g|W:");
+  p = fmt_decimal(p, water_ml, 3, 2);
+  fmt_end(fmt_text(p, "L"));
+}
+
+static void printf_status(char *out, int beans_g, int water_ml) {
+  snprintf(out, 32, "B:%.0fg|W:%.2fL", (float)beans_g, water_ml / 1000.0f);
+}
+
+static void fixed_next_brew(char *out, uint8_t day, uint8_t month, uint8_t hour, uint8_t minute, uint8_t cups) {
+  char *p = fmt_text(out, "NEXT ");
+  p = fmt_date(p, day, month);
+  *p++ = ' ';
+  p = fmt_time(p, hour, minute);
+  *p++ = ' ';
+  p = fmt_uint(p, cups, 0, ' ');
+  fmt_end(fmt_text(p, "C"));
+}
+
+static void printf_next_brew(char *out, uint8_t day, uint8_t month, uint8_t hour, uint8_t minute, uint8_t cups) {
+  snprintf(out, 32, "NEXT %02d/%02d %02d:%02d %dC", day, month, hour, minute, cups);
+}
+
+// ---------------------------------- Equivalence ---------------------------------- //
+// snprintf rounds the binary float, so a value exactly halfway at display
+// resolution (0.125 L, 0.015 L stored as 0.01499...) lands either way; the
+// formatter always rounds those half away from zero. They are counted, not failed.
+static int check_equivalence(int *ties) {
+  char a[32], b[32];
+  int mismatches = 0;
+
+  for (int t = -400; t <= 1250; t++) {
+    for (int h = 0; h <= 1000; h += 7) {
+      fixed_ambient(a, t, h);
+      printf_ambient(b, t, h);
+      if (strcmp(a, b) != 0) {
+        printf("ambient mismatch: '%s' vs '%s'\n", a, b);
+        mismatches++;
+      }
+    }
+  }
+
+  for (int beans = 0; beans <= 250; beans += 10) {
+    for (int water = 0; water <= 1000; water++) {
+      fixed_status(a, beans, water);
+      printf_status(b, beans, water);
+      if (strcmp(a, b) == 0) continue;
+      if (water % 10 == 5) {
+        if (beans == 0) (*ties)++;
+      } else {
+        printf("status mismatch: '%s' vs '%s'\n", a, b);
+        mismatches++;
+      }
+    }
+  }
+
+  for (int day = 1; day <= 31; day++) {
+    for (int hour = 0; hour < 24; hour++) {
+      for (int minute = 0; minute < 60; minute += 13) {
+        fixed_next_brew(a, day, 12, hour, minute, 1 + minute % 5);
+        printf_next_brew(b, day, 12, hour, minute, 1 + minute % 5);
+        if (strcmp(a, b) != 0) {
+          printf("next brew mismatch: '%s' vs '%s'\n", a, b);
+          mismatches++;
+        }
+      }
+    }
+  }
+  return mismatches;
+}
+
+// ---------------------------------- Timing ---------------------------------- //
+static volatile char sink;
+
+#define BENCH(name, ...)                                        \
+  do {                                                          \
+    char out[32];                                               \
+    uint32_t best = UINT32_MAX;                                 \
+    for (int round = 0; round < BENCH_ROUNDS; round++) {        \
+      uint32_t start = now_ns();                                \
+      for (uint32_t i = 0; i < BENCH_BATCH; i++) {              \
+        __VA_ARGS__;                                            \
+        sink += out[3];                                         \
+      }                                                         \
+      uint32_t elapsed = now_ns() - start;                      \
+      if (elapsed < best) best = elapsed;                       \
+    }                                                           \
+    printf("  %-28s %8.1f ns/field\n", name, (double)best / BENCH_BATCH); \
+  } while (0)
+
+int main(void) {
+  int ties = 0;
+  int mismatches = check_equivalence(&ties);
+  printf("equivalence: %d mismatches, %d half-way water levels now rounded up\n", mismatches, ties);
+
+  printf("per field (best of %d batches of %d):\n", BENCH_ROUNDS, BENCH_BATCH);
+  BENCH("snprintf ambient", printf_ambient(out, 237 + (i & 7), 551));
+  BENCH("lcd_format ambient", fixed_ambient(out, 237 + (i & 7), 551));
+  BENCH("snprintf status", printf_status(out, 230, 600 + (i & 7)));
+  BENCH("lcd_format status", fixed_status(out, 230, 600 + (i & 7)));
+  BENCH("snprintf next brew", printf_next_brew(out, 3, 1, 7, i & 31, 2));
+  BENCH("lcd_format next brew", fixed_next_brew(out, 3, 1, 7, i & 31, 2));
+
+  return mismatches != 0;
+}
@@ -0,0 +1,25 @@
+// hardware/adc.h (host shim)
+
+#ifndef HARDWARE_ADC_H
+#define HARDWARE_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+  volatile uint32_t fifo; // Only its address is used, as a DMA read source
+} adc_hw_t;
+
+extern adc_hw_t host_adc_hw;
+#define adc_hw (&host_adc_hw)
+
+void adc_init(void);
+void adc_gpio_init(unsigned int gpio);
+void adc_select_input(unsigned int input);
+uint16_t adc_read(void);
+void adc_set_round_robin(unsigned int input_mask);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+
+#endif // HARDWARE_ADC_H
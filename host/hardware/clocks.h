@@ -0,0 +1,8 @@
+// hardware/clocks.h (host shim)
+
+#ifndef HARDWARE_CLOCKS_H
+#define HARDWARE_CLOCKS_H
+
+void clocks_init(void); // Back to the PLLs at full speed
+
+#endif // HARDWARE_CLOCKS_H
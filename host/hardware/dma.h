@@ -0,0 +1,42 @@
+// hardware/dma.h (host shim)
+// Only ADC-paced transfers into memory are modelled.
+
+#ifndef HARDWARE_DMA_H
+#define HARDWARE_DMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUM_DMA_CHANNELS 12
+#define DREQ_ADC 36
+
+enum dma_channel_transfer_size {
+  DMA_SIZE_8 = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2
+};
+
+typedef struct {
+  enum dma_channel_transfer_size size;
+  bool read_increment;
+  bool write_increment;
+  unsigned int dreq;
+  unsigned int chain_to;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+void dma_channel_configure(unsigned int channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, unsigned int transfer_count, bool trigger);
+void dma_channel_set_write_addr(unsigned int channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_irq0_enabled(unsigned int channel, bool enabled);
+bool dma_channel_get_irq0_status(unsigned int channel);
+void dma_channel_acknowledge_irq0(unsigned int channel);
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { c->size = size; }
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) { c->read_increment = incr; }
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+static inline void channel_config_set_dreq(dma_channel_config *c, unsigned int dreq) { c->dreq = dreq; }
+static inline void channel_config_set_chain_to(dma_channel_config *c, unsigned int chain_to) { c->chain_to = chain_to; }
+
+#endif // HARDWARE_DMA_H
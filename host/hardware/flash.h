@@ -0,0 +1,25 @@
+// hardware/flash.h (host shim)
+// The QSPI flash is an array in host memory, mapped at XIP_BASE. Erase and program
+// keep NOR semantics (erase sets bits, program only clears them) and take their
+// typical time with interrupts off and core 1 stalled, as XIP is down meanwhile.
+
+#ifndef HARDWARE_FLASH_H
+#define HARDWARE_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+
+#define FLASH_PAGE_SIZE   256u
+#define FLASH_SECTOR_SIZE 4096u
+
+extern uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)host_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);                      // Whole sectors
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count); // Whole pages
+
+#endif // HARDWARE_FLASH_H
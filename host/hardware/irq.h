@@ -0,0 +1,16 @@
+// hardware/irq.h (host shim)
+
+#ifndef HARDWARE_IRQ_H
+#define HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+typedef void (*irq_handler_t)(void);
+
+#define DMA_IRQ_0    11
+#define IO_IRQ_BANK0 13
+
+static inline void irq_set_enabled(unsigned int num, bool enabled) { (void)num; (void)enabled; }
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler);
+
+#endif // HARDWARE_IRQ_H
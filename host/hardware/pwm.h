@@ -0,0 +1,21 @@
+// hardware/pwm.h (host shim)
+
+#ifndef HARDWARE_PWM_H
+#define HARDWARE_PWM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NUM_PWM_SLICES 8
+
+static inline unsigned int pwm_gpio_to_slice_num(unsigned int gpio) { return (gpio >> 1u) & 7u; }
+static inline unsigned int pwm_gpio_to_channel(unsigned int gpio) { return gpio & 1u; }
+
+void pwm_set_clkdiv(unsigned int slice_num, float divider);
+void pwm_set_clkdiv_int_frac(unsigned int slice_num, uint8_t integer, uint8_t fract);
+void pwm_set_wrap(unsigned int slice_num, uint16_t wrap);
+void pwm_set_chan_level(unsigned int slice_num, unsigned int chan, uint16_t level);
+void pwm_set_gpio_level(unsigned int gpio, uint16_t level);
+void pwm_set_enabled(unsigned int slice_num, bool enabled);
+
+#endif // HARDWARE_PWM_H
@@ -0,0 +1,16 @@
+// hardware/sync.h (host shim)
+
+#ifndef HARDWARE_SYNC_H
+#define HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+void __sev(void);
+void __wfe(void);
+static inline void __dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __compiler_memory_barrier(void) { __asm__ volatile ("" : : : "memory"); }
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif // HARDWARE_SYNC_H
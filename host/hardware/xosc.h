@@ -0,0 +1,10 @@
+// hardware/xosc.h (host shim)
+
+#ifndef HARDWARE_XOSC_H
+#define HARDWARE_XOSC_H
+
+// Stops the crystal until an edge on a pin enabled with gpio_set_dormant_irq_enabled().
+// Unlike the chip, the shim keeps the timer and its alarms running meanwhile.
+void xosc_dormant(void);
+
+#endif // HARDWARE_XOSC_H
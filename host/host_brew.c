@@ -0,0 +1,80 @@
+// host_brew.c
+// Host driver: boots the firmware against the shim and runs back-to-back brew
+// cycles under virtual time, reporting virtual duration and host throughput.
+//
+// Usage: coffee_host [cycles] [cups] [--profile]
+//   --profile: appends a profile dump of the brews (decode with host/tools/profile_decode.c)
+
+#include "host_hal.h"
+#include "pico/stdlib.h"
+#include "internal_operations.h"
+#include "lcd_i2c.h"
+#include "display_task.h"
+#include "i2c_bus.h"
+#include "state.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DHT_PIN 8
+#define IR_SENSOR_GPIO_PIN 1
+
+extern int water_ml;
+extern int coffee_beans_g;
+extern State current_state;
+
+static double wall_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  int cycles = (argc > 1) ? atoi(argv[1]) : 100;
+  int cups = (argc > 2) ? atoi(argv[2]) : 2;
+  bool profile = (argc > 3) && strcmp(argv[3], "--profile") == 0;
+
+  host_dht_attach(DHT_PIN);
+  host_ir_attach(IR_SENSOR_GPIO_PIN);
+  host_rtc_set(2025, 1, 1, 7, 30, 0);
+
+  setup_machine();
+  uint64_t boot_us = host_now_us();
+
+  double wall_start = wall_seconds();
+  uint64_t virtual_start = host_now_us();
+  host_i2c_reset_stats();
+  i2c_bus_reset_stats();
+  profile_reset();
+
+  for (int i = 0; i < cycles; i++) {
+    water_ml = 1000;
+    coffee_beans_g = 250;
+    current_state = STATE_BREWING;
+    prepare_coffee(cups);
+  }
+
+  double wall = wall_seconds() - wall_start;
+  uint64_t virtual_us = host_now_us() - virtual_start;
+  host_i2c_stats lcd = host_i2c_get_stats(LCD_ADDR);
+  i2c_bus_stats driver = i2c_bus_get_stats(I2C_DEVICE_LCD);
+
+  host_lcd_dump();
+  printf("boot:            %.3f s virtual\n", boot_us / 1e6);
+  printf("brew cycles:     %d x %d cups\n", cycles, cups);
+  printf("per brew:        %.3f s virtual\n", cycles ? virtual_us / 1e6 / cycles : 0.0);
+  printf("lcd per brew:    %u transactions, %u bytes, %.1f ms on the bus\n",
+         cycles ? lcd.transactions / cycles : 0, cycles ? lcd.bytes / cycles : 0,
+         cycles ? lcd.busy_us / 1e3 / cycles : 0.0);
+  printf("lcd bus manager: %u transactions, %u bytes on the bus at %u kHz\n",
+         cycles ? driver.transactions / cycles : 0, cycles ? driver.bytes / cycles : 0,
+         i2c_bus_get_baudrate() / 1000);
+  display_task_stats display = display_task_get_stats();
+  printf("display queue:   %u commands, max depth %u, %u waits for room\n",
+         display.commands, display.max_depth, display.full_waits);
+  printf("host throughput: %.0f brews/s\n", wall > 0 ? cycles / wall : 0.0);
+  if (profile) profile_dump();
+  return 0;
+}
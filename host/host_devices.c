@@ -0,0 +1,434 @@
+// host_devices.c
+// Behavioural models of the peripherals wired to the Pico in diagram.json:
+// - LCD 20x4 behind a PCF8574 I2C expander (address 0x27)
+// - DS1307 RTC (address 0x68), with its 1 Hz square-wave output
+// - DHT22 single-wire sensor
+// - NEC IR receiver (active low, falling edges only)
+
+#include "host_hal.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MODEL_LCD_ADDR 0x27
+#define MODEL_RTC_ADDR 0x68
+#define MODEL_LCD_ROWS 4
+#define MODEL_LCD_COLS 20
+
+// ---------------------------------- LCD (PCF8574 + HD44780) ---------------------------------- //
+// Expander bits: P0 = RS, P2 = E, P3 = backlight, P4..P7 = D4..D7.
+// The controller latches a nibble on the falling edge of E, with RS sampled
+// while E is high. Two nibbles (high first) make one byte.
+static struct {
+  uint8_t ddram[128];
+  uint8_t cgram[64];
+  uint8_t addr;
+  bool to_cgram;
+  bool display_on;
+  bool e_high;
+  bool rs;
+  uint8_t nibble;
+  bool have_high;
+  uint8_t high;
+  bool backlight;
+  uint64_t backlight_since;
+  uint64_t backlight_us;  // Lit time before backlight_since
+} lcd = {.display_on = true};
+
+static void lcd_model_command(uint8_t cmd) {
+  if (cmd & 0x80) {
+    lcd.addr = cmd & 0x7F;
+    lcd.to_cgram = false;
+  } else if (cmd & 0x40) {
+    lcd.addr = cmd & 0x3F;
+    lcd.to_cgram = true;
+  } else if (cmd & 0x08) {
+    lcd.display_on = (cmd & 0x04) != 0;
+  } else if (cmd & 0x02) {
+    lcd.addr = 0;
+    lcd.to_cgram = false;
+  } else if (cmd == 0x01) {
+    memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+    lcd.addr = 0;
+    lcd.to_cgram = false;
+  }
+}
+
+static void lcd_model_data(uint8_t value) {
+  if (lcd.to_cgram) {
+    lcd.cgram[lcd.addr & 0x3F] = value;
+    lcd.addr = (lcd.addr + 1) & 0x3F;
+  } else {
+    lcd.ddram[lcd.addr & 0x7F] = value;
+    lcd.addr = (lcd.addr + 1) & 0x7F;
+  }
+}
+
+static void lcd_model_write(uint8_t value) {
+  bool lit = (value & 0x08) != 0;
+  if (lit != lcd.backlight) {
+    if (lcd.backlight) lcd.backlight_us += host_now_us() - lcd.backlight_since;
+    lcd.backlight_since = host_now_us();
+    lcd.backlight = lit;
+  }
+
+  bool e = (value & 0x04) != 0;
+  if (e) {
+    lcd.rs = (value & 0x01) != 0;
+    lcd.nibble = value >> 4;
+  } else if (lcd.e_high) {
+    if (!lcd.have_high) {
+      lcd.high = lcd.nibble;
+      lcd.have_high = true;
+    } else {
+      uint8_t byte = (uint8_t)((lcd.high << 4) | lcd.nibble);
+      lcd.have_high = false;
+      if (lcd.rs) lcd_model_data(byte);
+      else lcd_model_command(byte);
+    }
+  }
+  lcd.e_high = e;
+}
+
+void host_lcd_row(int row, char *out, size_t size) {
+  static const uint8_t row_offsets[MODEL_LCD_ROWS] = {0x00, 0x40, 0x14, 0x54};
+  size_t n = (size - 1 < MODEL_LCD_COLS) ? size - 1 : MODEL_LCD_COLS;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t c = lcd.ddram[(row_offsets[row & 3] + i) & 0x7F];
+    out[i] = (c >= 0x20 && c < 0x7F) ? (char)c : (c < 8 ? '#' : '?');
+  }
+  out[n] = '\0';
+}
+
+bool host_lcd_backlight(void) {
+  return lcd.backlight;
+}
+
+uint64_t host_dev_lcd_backlight_us(void) {
+  uint64_t now = host_now_us();
+  return lcd.backlight_us + (lcd.backlight && now > lcd.backlight_since ? now - lcd.backlight_since : 0);
+}
+
+void host_lcd_dump(void) {
+  char row[MODEL_LCD_COLS + 1];
+  printf("+--------------------+\n");
+  for (int r = 0; r < MODEL_LCD_ROWS; r++) {
+    host_lcd_row(r, row, sizeof(row));
+    printf("|%s|\n", row);
+  }
+  printf("+--------------------+\n");
+}
+
+// ---------------------------------- RTC (DS1307) ---------------------------------- //
+static struct {
+  int64_t epoch_s;     // Calendar seconds at virtual time zero
+  uint8_t pointer;
+  uint8_t control;
+  uint8_t ram[56];
+  uint32_t reads;
+  int sqw_gpio;
+  alarm_id_t sqw_alarm;
+} rtc = {.epoch_s = 1735725600, .sqw_gpio = -1}; // 2025-01-01 10:00:00
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t days_from_civil(int y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int *y, unsigned *m, unsigned *d) {
+  z += 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  unsigned doe = (unsigned)(z - era * 146097);
+  unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned mp = (5 * doy + 2) / 153;
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp < 10 ? mp + 3 : mp - 9;
+  *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+static uint8_t to_bcd(unsigned v) {
+  return (uint8_t)(((v / 10) << 4) | (v % 10));
+}
+
+static unsigned from_bcd(uint8_t v) {
+  return (v & 0x0F) + ((v >> 4) * 10);
+}
+
+static void rtc_registers(uint8_t regs[8]) {
+  int64_t t = rtc.epoch_s + (int64_t)(host_now_us() / 1000000);
+  int64_t days = t / 86400;
+  int64_t secs = t % 86400;
+  int y;
+  unsigned m, d;
+  civil_from_days(days, &y, &m, &d);
+
+  regs[0] = to_bcd((unsigned)(secs % 60));
+  regs[1] = to_bcd((unsigned)(secs / 60 % 60));
+  regs[2] = to_bcd((unsigned)(secs / 3600));
+  regs[3] = (uint8_t)((days + 4) % 7 + 1); // 1970-01-01 was a Thursday; 1 = Sunday
+  regs[4] = to_bcd(d);
+  regs[5] = to_bcd(m);
+  regs[6] = to_bcd((unsigned)(y % 100));
+  regs[7] = rtc.control;
+}
+
+void host_rtc_set(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
+  int64_t t = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  rtc.epoch_s = t - (int64_t)(host_now_us() / 1000000);
+}
+
+uint32_t host_rtc_reads(void) {
+  return rtc.reads;
+}
+
+// SQWE set with RS1:RS0 = 00; other rates are not modelled
+static bool rtc_sqw_enabled(void) {
+  return rtc.sqw_gpio >= 0 && (rtc.control & 0x13) == 0x10;
+}
+
+// The output falls as the seconds register advances, which is on every whole second of virtual time
+static int64_t rtc_sqw_alarm(alarm_id_t id, void *user_data) {
+  (void)id;
+  (void)user_data;
+  if (!rtc_sqw_enabled()) {
+    rtc.sqw_alarm = 0;
+    return 0;
+  }
+  host_gpio_edge((uint)rtc.sqw_gpio, GPIO_IRQ_EDGE_FALL);
+  return -1000000; // From the previous edge, so the edges stay on whole seconds
+}
+
+static void rtc_sqw_update(void) {
+  if (!rtc_sqw_enabled() || rtc.sqw_alarm != 0) return;
+  uint64_t next = (host_now_us() / 1000000 + 1) * 1000000;
+  rtc.sqw_alarm = add_alarm_at(next, rtc_sqw_alarm, NULL, true);
+}
+
+void host_rtc_attach_sqw(uint gpio) {
+  rtc.sqw_gpio = (int)gpio;
+  rtc_sqw_update();
+}
+
+static bool rtc_model_write(const uint8_t *src, size_t len) {
+  if (len == 0) return true;
+  rtc.pointer = src[0] & 0x3F;
+  if (len == 1) return true;
+
+  uint8_t regs[8];
+  rtc_registers(regs);
+  bool time_written = false;
+  for (size_t i = 1; i < len; i++) {
+    uint8_t reg = rtc.pointer;
+    if (reg < 7) {
+      regs[reg] = src[i];
+      time_written = true;
+    } else if (reg == 7) {
+      rtc.control = src[i];
+      rtc_sqw_update();
+    } else {
+      rtc.ram[reg - 8] = src[i];
+    }
+    rtc.pointer = (rtc.pointer + 1) & 0x3F;
+  }
+  if (time_written) {
+    host_rtc_set(2000 + from_bcd(regs[6]), from_bcd(regs[5]), from_bcd(regs[4]),
+                 from_bcd(regs[2] & 0x3F), from_bcd(regs[1]), from_bcd(regs[0] & 0x7F));
+  }
+  return true;
+}
+
+static bool rtc_model_read(uint8_t *dst, size_t len) {
+  uint8_t regs[8];
+  rtc_registers(regs);
+  rtc.reads++;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t reg = rtc.pointer;
+    dst[i] = (reg < 8) ? regs[reg] : rtc.ram[reg - 8];
+    rtc.pointer = (rtc.pointer + 1) & 0x3F;
+  }
+  return true;
+}
+
+// ---------------------------------- I2C Dispatch ---------------------------------- //
+bool host_dev_i2c_write(uint8_t addr, const uint8_t *src, size_t len) {
+  switch (addr) {
+    case MODEL_LCD_ADDR:
+      for (size_t i = 0; i < len; i++) lcd_model_write(src[i]);
+      return true;
+    case MODEL_RTC_ADDR:
+      return rtc_model_write(src, len);
+    default:
+      return false;
+  }
+}
+
+bool host_dev_i2c_read(uint8_t addr, uint8_t *dst, size_t len) {
+  switch (addr) {
+    case MODEL_LCD_ADDR:
+      memset(dst, 0xFF, len);
+      return true;
+    case MODEL_RTC_ADDR:
+      return rtc_model_read(dst, len);
+    default:
+      return false;
+  }
+}
+
+// ---------------------------------- DHT22 ---------------------------------- //
+// After the host releases the line the sensor answers with:
+// 30 us high, 80 us low, 80 us high, then 40 bits of (50 us low + 26/70 us high),
+// a final 50 us low, and the line idles high again.
+#define DHT_SEGMENTS (3 + 40 * 2 + 1)
+
+static struct {
+  int gpio;
+  bool responding;
+  bool held_low;
+  uint64_t low_since;
+  bool framing;
+  uint64_t frame_start;
+  uint16_t segment_end[DHT_SEGMENTS]; // Cumulative end time of each segment, in us
+  uint32_t reads;
+  uint16_t humidity_x10;
+  int16_t temp_x10;
+} dht = {.gpio = -1, .responding = true, .humidity_x10 = 550, .temp_x10 = 240};
+
+static void dht_build_frame(void) {
+  uint8_t bytes[5];
+  uint16_t t = (dht.temp_x10 < 0) ? (uint16_t)(0x8000 | -dht.temp_x10) : (uint16_t)dht.temp_x10;
+  bytes[0] = dht.humidity_x10 >> 8;
+  bytes[1] = dht.humidity_x10 & 0xFF;
+  bytes[2] = t >> 8;
+  bytes[3] = t & 0xFF;
+  bytes[4] = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+
+  uint16_t at = 0;
+  int s = 0;
+  at += 30; dht.segment_end[s++] = at;
+  at += 80; dht.segment_end[s++] = at;
+  at += 80; dht.segment_end[s++] = at;
+  for (int bit = 0; bit < 40; bit++) {
+    bool one = (bytes[bit / 8] >> (7 - bit % 8)) & 1;
+    at += 50; dht.segment_end[s++] = at;
+    at += one ? 70 : 26; dht.segment_end[s++] = at;
+  }
+  at += 50; dht.segment_end[s++] = at;
+}
+
+static int64_t dht_edge_alarm(alarm_id_t id, void *user_data) {
+  (void)id;
+  if (dht.gpio >= 0) host_gpio_edge((uint)dht.gpio, (uint32_t)(uintptr_t)user_data);
+  return 0;
+}
+
+// Raises the GPIO interrupts of the frame: every segment boundary is an edge
+static void dht_schedule_edges(void) {
+  for (int s = 0; s < DHT_SEGMENTS; s++) {
+    uint32_t edge = (s % 2 == 0) ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE;
+    add_alarm_at(dht.frame_start + dht.segment_end[s], dht_edge_alarm, (void *)(uintptr_t)edge, true);
+  }
+}
+
+void host_dht_attach(uint gpio) {
+  dht.gpio = (int)gpio;
+}
+
+void host_dht_set(float temp_celsius, float humidity) {
+  dht.temp_x10 = (int16_t)(temp_celsius * 10.0f + (temp_celsius < 0 ? -0.5f : 0.5f));
+  dht.humidity_x10 = (uint16_t)(humidity * 10.0f + 0.5f);
+}
+
+void host_dht_set_responding(bool responding) {
+  dht.responding = responding;
+}
+
+uint32_t host_dht_reads(void) {
+  return dht.reads;
+}
+
+void host_dev_gpio_dir_changed(uint gpio, bool out, bool level) {
+  if ((int)gpio != dht.gpio) return;
+  if (out && !level) {
+    if (!dht.held_low) {
+      dht.held_low = true;
+      dht.low_since = host_now_us();
+    }
+    dht.framing = false;
+    return;
+  }
+  // Start pulse must be at least 1 ms long
+  if (dht.held_low && host_now_us() - dht.low_since >= 1000 && dht.responding) {
+    dht_build_frame();
+    dht.framing = true;
+    dht.frame_start = host_now_us();
+    dht.reads++;
+    dht_schedule_edges();
+  }
+  dht.held_low = false;
+}
+
+// ---------------------------------- GPIO Inputs ---------------------------------- //
+bool host_dev_gpio_input(uint gpio, bool *level) {
+  if ((int)gpio != dht.gpio) return false;
+  if (!dht.framing) {
+    *level = true;
+    return true;
+  }
+  uint64_t t = host_now_us() - dht.frame_start;
+  for (int s = 0; s < DHT_SEGMENTS; s++) {
+    if (t < dht.segment_end[s]) {
+      *level = (s % 2) == 0; // Segments alternate high/low, starting high
+      return true;
+    }
+  }
+  dht.framing = false;
+  *level = true;
+  return true;
+}
+
+// ---------------------------------- NEC IR Receiver ---------------------------------- //
+// Falling edges of a frame: leader at 0, first data mark 13.5 ms later, then one
+// edge per bit (1.125 ms for a 0, 2.25 ms for a 1), LSB first; the 34th edge is
+// the stop mark. A repeat frame is a leader followed by an edge 11.25 ms later.
+static int ir_gpio = -1;
+
+static int64_t ir_edge_alarm(alarm_id_t id, void *user_data) {
+  (void)id;
+  (void)user_data;
+  if (ir_gpio >= 0) host_gpio_edge((uint)ir_gpio, GPIO_IRQ_EDGE_FALL);
+  return 0;
+}
+
+static void ir_edge_at(uint64_t at_us) {
+  add_alarm_at(at_us, ir_edge_alarm, NULL, true);
+}
+
+void host_ir_attach(uint gpio) {
+  ir_gpio = (int)gpio;
+}
+
+uint64_t host_ir_press_at(uint64_t at_us, uint8_t address, uint8_t command) {
+  uint32_t raw = address | ((uint32_t)(address ^ 0xFF) << 8) |
+                 ((uint32_t)command << 16) | ((uint32_t)(command ^ 0xFF) << 24);
+  uint64_t t = at_us;
+  ir_edge_at(t);
+  t += 13500;
+  ir_edge_at(t);
+  for (int bit = 0; bit < 32; bit++) {
+    t += ((raw >> bit) & 1) ? 2250 : 1125;
+    ir_edge_at(t);
+  }
+  return t;
+}
+
+void host_ir_repeat_at(uint64_t at_us) {
+  ir_edge_at(at_us);
+  ir_edge_at(at_us + 11250);
+}
@@ -0,0 +1,862 @@
+// host_hal.c
+// Linux implementation of the Pico SDK calls used by the firmware.
+// Time is virtual: nothing here ever waits on the wall clock.
+
+#include "host_hal.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+#include "hardware/xosc.h"
+#include "hardware/clocks.h"
+#include "hardware/flash.h"
+#include "pico/multicore.h"
+#include "pico/sleep.h"
+#include "pico/flash.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#define HOST_MAX_ALARMS 512
+
+typedef struct {
+  alarm_id_t id;
+  uint64_t at;
+  uint32_t seq;           // Keeps alarms due at the same instant in FIFO order
+  alarm_callback_t callback;
+  void *user_data;
+  bool active;
+  bool firing;            // Slot stays reserved while its callback runs so it can be re-armed
+} host_alarm;
+
+static uint64_t now_us = 0; // Clock of the core that is running
+static int irq_depth = 0;
+static host_alarm alarms[HOST_MAX_ALARMS];
+static alarm_id_t next_alarm_id = 1;
+static uint32_t next_seq = 0;
+static bool event_flags[2];    // WFE event register of each core
+static uint64_t event_at[2];   // When each register was last set
+
+// Core 1 is a coroutine with its own clock. It only runs while core 0 moves its
+// clock forward, and never past the instant core 0 is heading to, so both cores
+// see each other's effects in time order without real threads.
+#define HOST_CORE1_STACK (256 * 1024)
+
+typedef enum {
+  CORE1_OFF,
+  CORE1_RUNNING,
+  CORE1_SLEEPING,  // Until wake_at
+  CORE1_WAITING,   // In __wfe() until an event is signalled (or wake_at, from best_effort_wfe_or_timeout)
+} core1_state;
+
+static struct {
+  core1_state state;
+  ucontext_t context;
+  ucontext_t core0_context;
+  void (*entry)(void);
+  uint64_t now_us;    // Saved clock while core 0 runs
+  uint64_t wake_at;
+  uint64_t horizon;   // Core 1 hands back to core 0 before going past this instant
+} core1;
+
+static uint current_core = 0;
+static bool core0_waiting = false; // Core 0 is in WFE: an event from core 1 wakes it early
+
+// ---------------------------------- Virtual Clock ---------------------------------- //
+uint64_t host_now_us(void) {
+  return now_us;
+}
+
+bool host_in_irq(void) {
+  return irq_depth > 0;
+}
+
+static host_alarm *earliest_alarm_before(uint64_t limit) {
+  host_alarm *best = NULL;
+  for (int i = 0; i < HOST_MAX_ALARMS; i++) {
+    host_alarm *a = &alarms[i];
+    if (!a->active || a->at > limit) continue;
+    if (best == NULL || a->at < best->at || (a->at == best->at && a->seq < best->seq)) {
+      best = a;
+    }
+  }
+  return best;
+}
+
+// Same rule as the SDK: a positive return re-arms that long after the callback returns,
+// a negative one that long after the time the alarm was due
+static void fire_alarm(host_alarm *a) {
+  alarm_id_t id = a->id;
+  uint64_t scheduled = a->at;
+  a->active = false;
+  a->firing = true;
+
+  irq_depth++;
+  int64_t again = a->callback(id, a->user_data);
+  irq_depth--;
+
+  a->firing = false;
+  if (again != 0) {
+    a->id = id;
+    a->at = (again < 0) ? scheduled + (uint64_t)(-again) : now_us + (uint64_t)again;
+    a->seq = next_seq++;
+    a->active = true;
+  }
+}
+
+static inline uint64_t max_u64(uint64_t a, uint64_t b) {
+  return a > b ? a : b;
+}
+
+// ---------------------------------- Multicore ---------------------------------- //
+static void core1_yield(void) {
+  swapcontext(&core1.context, &core1.core0_context);
+}
+
+static void core1_switch_in(uint64_t horizon) {
+  uint64_t core0_now = now_us;
+  core1.horizon = horizon;
+  core1.state = CORE1_RUNNING;
+  now_us = core1.now_us;
+  current_core = 1;
+  swapcontext(&core1.core0_context, &core1.context);
+  current_core = 0;
+  core1.now_us = now_us;
+  now_us = core0_now;
+}
+
+// Lets core 1 catch up to horizon. Stops early when core 1 wakes a waiting core 0.
+static void core1_run(uint64_t horizon) {
+  while (true) {
+    if (core1.state == CORE1_SLEEPING && core1.wake_at <= horizon) {
+      core1.now_us = max_u64(core1.now_us, core1.wake_at);
+    } else if (core1.state == CORE1_WAITING && (event_flags[1] || core1.wake_at <= horizon)) {
+      uint64_t wake = core1.wake_at;
+      if (event_flags[1] && event_at[1] < wake) wake = event_at[1];
+      core1.now_us = max_u64(core1.now_us, wake);
+    } else {
+      return;
+    }
+    core1_switch_in(horizon);
+    if (core0_waiting && event_flags[0]) return;
+  }
+}
+
+static void core1_trampoline(void) {
+  core1.entry();
+  core1.state = CORE1_OFF;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+  static uint8_t *stack = NULL;
+  if (stack == NULL) stack = malloc(HOST_CORE1_STACK);
+  getcontext(&core1.context);
+  core1.context.uc_stack.ss_sp = stack;
+  core1.context.uc_stack.ss_size = HOST_CORE1_STACK;
+  core1.context.uc_link = &core1.core0_context;
+  makecontext(&core1.context, core1_trampoline, 0);
+  core1.entry = entry;
+  core1.now_us = now_us;
+  core1.wake_at = now_us;
+  core1.state = CORE1_SLEEPING;
+}
+
+uint get_core_num(void) {
+  return current_core;
+}
+
+// ---------------------------------- Clock Advance ---------------------------------- //
+// Core 0: runs every alarm due up to target in time order (letting core 1 catch up
+// before each one), then settles the clock on target. Interrupt handlers do not
+// nest: time spent inside a callback just delays the others.
+// Core 1: has no interrupts; it hands back to core 0 when it would pass core 0.
+static void run_until(uint64_t target) {
+  if (current_core == 1) {
+    if (target > core1.horizon) {
+      core1.state = CORE1_SLEEPING;
+      core1.wake_at = target;
+      core1_yield();
+    }
+    if (target > now_us) now_us = target;
+    return;
+  }
+  if (irq_depth == 0) {
+    host_alarm *a;
+    while ((a = earliest_alarm_before(target)) != NULL) {
+      core1_run(a->at);
+      if (a->at > now_us) now_us = a->at;
+      fire_alarm(a);
+    }
+    core1_run(target);
+  }
+  if (target > now_us) now_us = target;
+}
+
+// Core 0 WFE: sleeps until the next interrupt before limit, or until core 1 signals an event
+static void core0_wait(uint64_t limit) {
+  host_alarm *a = earliest_alarm_before(limit);
+  uint64_t target = a != NULL ? a->at : limit;
+  if (irq_depth == 0) {
+    core0_waiting = true;
+    core1_run(target);
+    core0_waiting = false;
+    if (event_flags[0]) {
+      now_us = max_u64(now_us, event_at[0]);
+      return;
+    }
+  }
+  run_until(target);
+}
+
+void host_advance_us(uint64_t us) {
+  run_until(now_us + us);
+}
+
+uint64_t time_us_64(void) {
+  run_until(now_us + HOST_POLL_COST_US);
+  return now_us;
+}
+
+void sleep_us(uint64_t us) {
+  run_until(now_us + us);
+}
+
+void sleep_ms(uint32_t ms) {
+  run_until(now_us + (uint64_t)ms * 1000);
+}
+
+void sleep_until(absolute_time_t target) {
+  run_until(target);
+}
+
+// WFE: returns at once if an event was signalled, otherwise sleeps until the next interrupt.
+// SEV sets the event register of both cores, as on the RP2040.
+void __sev(void) {
+  for (int core = 0; core < 2; core++) {
+    event_flags[core] = true;
+    event_at[core] = now_us;
+  }
+  if (current_core == 1 && core0_waiting) {
+    // Hands back right away so core 0 wakes at this instant
+    core1.state = CORE1_SLEEPING;
+    core1.wake_at = now_us;
+    core1_yield();
+  }
+}
+
+void __wfe(void) {
+  uint core = current_core;
+  if (!event_flags[core]) {
+    if (core == 1) {
+      core1.state = CORE1_WAITING;
+      core1.wake_at = UINT64_MAX;
+      core1_yield();
+    } else {
+      host_alarm *a = earliest_alarm_before(UINT64_MAX);
+      uint64_t limit = now_us + HOST_POLL_COST_US;
+      if (a != NULL) limit = a->at;
+      else if (core1.state != CORE1_OFF && core1.wake_at != UINT64_MAX) limit = max_u64(limit, core1.wake_at);
+      core0_wait(limit);
+    }
+  }
+  event_flags[core] = false;
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp) {
+  uint core = current_core;
+  if (!event_flags[core]) {
+    if (core == 1) {
+      // Core 0 is ahead: an event it signals before the timeout ends the wait there
+      if ((uint64_t)timeout_timestamp > core1.horizon) {
+        core1.state = CORE1_WAITING;
+        core1.wake_at = is_at_the_end_of_time(timeout_timestamp) ? UINT64_MAX : timeout_timestamp;
+        core1_yield();
+      }
+      if (!event_flags[core] && (uint64_t)timeout_timestamp > now_us) now_us = timeout_timestamp;
+    } else {
+      core0_wait(timeout_timestamp);
+    }
+  }
+  event_flags[core] = false;
+  return now_us >= timeout_timestamp;
+}
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+  if (time <= now_us) {
+    if (!fire_if_past) return 0;
+    time = now_us;
+  }
+  for (int i = 0; i < HOST_MAX_ALARMS; i++) {
+    if (!alarms[i].active && !alarms[i].firing) {
+      alarms[i] = (host_alarm) {next_alarm_id++, time, next_seq++, callback, user_data, true, false};
+      return alarms[i].id;
+    }
+  }
+  return -1; // No free slot, as the SDK reports a full alarm pool
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+  for (int i = 0; i < HOST_MAX_ALARMS; i++) {
+    if (alarms[i].active && alarms[i].id == alarm_id) {
+      alarms[i].active = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool stdio_init_all(void) {
+  return true;
+}
+
+// ---------------------------------- Clocks and Power ---------------------------------- //
+// Typical supply currents (mA at 5 V) for the power model; estimates, not measurements
+#define HOST_MA_PLL        24.0 // Cores at 125 MHz from the PLLs, mostly in WFE
+#define HOST_MA_XOSC        5.0 // clk_sys and clk_peri from the crystal, PLLs off
+#define HOST_MA_DORMANT     0.8 // Crystal stopped: regulator and pad leakage only
+#define HOST_MA_BOARD       2.5 // LCD controller, DHT22, DS1307 and IR receiver quiescent draw
+#define HOST_MA_BACKLIGHT  20.0 // LCD backlight LEDs
+#define HOST_XOSC_STARTUP_US 1000 // Crystal start-up after a dormant wake
+
+static struct {
+  host_clock_mode mode;
+  uint64_t since_us;
+  uint64_t mode_us[HOST_CLOCK_MODES];
+  uint32_t dormant_entries;
+  bool dormant;
+  bool woken;
+} power;
+
+static void clock_mode_set(host_clock_mode mode) {
+  power.mode_us[power.mode] += now_us - power.since_us;
+  power.mode = mode;
+  power.since_us = now_us;
+}
+
+void sleep_run_from_xosc(void) {
+  clock_mode_set(HOST_CLOCK_XOSC);
+}
+
+void sleep_power_up(void) {}
+
+void clocks_init(void) {
+  clock_mode_set(HOST_CLOCK_PLL);
+}
+
+// Sleeps until an enabled pin sees an edge; alarms keep firing on the way (see xosc.h)
+void xosc_dormant(void) {
+  clock_mode_set(HOST_CLOCK_DORMANT);
+  power.dormant_entries++;
+  power.dormant = true;
+  power.woken = false;
+  while (!power.woken && irq_depth == 0) {
+    event_flags[0] = false; // Neither SEV nor an alarm wakes a dormant chip
+    if (earliest_alarm_before(UINT64_MAX) == NULL) break; // Nothing left that could raise an edge
+    core0_wait(UINT64_MAX);
+  }
+  power.dormant = false;
+  clock_mode_set(HOST_CLOCK_XOSC);
+  sleep_us(HOST_XOSC_STARTUP_US);
+}
+
+host_power_stats host_power_get_stats(void) {
+  host_power_stats s = {{0}, host_dev_lcd_backlight_us(), power.dormant_entries};
+  for (int i = 0; i < HOST_CLOCK_MODES; i++) s.mode_us[i] = power.mode_us[i];
+  s.mode_us[power.mode] += host_now_us() - power.since_us;
+  return s;
+}
+
+double host_power_average_ma(const host_power_stats *from, const host_power_stats *to) {
+  static const double mode_ma[HOST_CLOCK_MODES] = {HOST_MA_PLL, HOST_MA_XOSC, HOST_MA_DORMANT};
+  double total_us = 0, charge = 0;
+  for (int i = 0; i < HOST_CLOCK_MODES; i++) {
+    double us = (double)(to->mode_us[i] - from->mode_us[i]);
+    total_us += us;
+    charge += us * mode_ma[i];
+  }
+  if (total_us <= 0) return 0.0;
+  charge += (double)(to->backlight_us - from->backlight_us) * HOST_MA_BACKLIGHT;
+  return charge / total_us + HOST_MA_BOARD;
+}
+
+// ---------------------------------- GPIO ---------------------------------- //
+typedef struct {
+  enum gpio_function function;
+  bool out;
+  bool level;
+  bool pull_up;
+  uint32_t irq_events;
+  uint32_t irq_pending;     // Latched events for raw handlers, cleared by gpio_acknowledge_irq()
+  uint32_t dormant_events;  // Edges that end xosc_dormant()
+  irq_handler_t raw_handler;
+} host_gpio;
+
+static host_gpio gpios[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_callback = NULL;
+
+void gpio_init(uint gpio) {
+  gpios[gpio].function = GPIO_FUNC_SIO;
+  gpios[gpio].out = false;
+  gpios[gpio].level = false;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+  gpios[gpio].function = fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+  gpios[gpio].out = out;
+  host_dev_gpio_dir_changed(gpio, out, gpios[gpio].level);
+}
+
+void gpio_put(uint gpio, bool value) {
+  gpios[gpio].level = value;
+  if (gpios[gpio].out) host_dev_gpio_dir_changed(gpio, true, value);
+}
+
+// One SIO write on the chip (GPIO_OUT_XOR); pins outside the mask keep their level
+void gpio_put_masked(uint32_t mask, uint32_t value) {
+  for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+    if (mask & (1u << gpio)) gpio_put(gpio, (value >> gpio) & 1u);
+  }
+}
+
+bool gpio_get(uint gpio) {
+  if (gpios[gpio].out) return gpios[gpio].level;
+  bool level;
+  if (host_dev_gpio_input(gpio, &level)) return level;
+  return gpios[gpio].pull_up;
+}
+
+void gpio_pull_up(uint gpio) {
+  gpios[gpio].pull_up = true;
+}
+
+void gpio_pull_down(uint gpio) {
+  gpios[gpio].pull_up = false;
+}
+
+void gpio_disable_pulls(uint gpio) {
+  gpios[gpio].pull_up = false;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+  if (enabled) gpios[gpio].irq_events |= events;
+  else gpios[gpio].irq_events &= ~events;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+  gpio_set_irq_enabled(gpio, events, enabled);
+  gpio_callback = callback;
+}
+
+void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler) {
+  gpios[gpio].raw_handler = handler;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio) {
+  return gpios[gpio].irq_pending;
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t events) {
+  gpios[gpio].irq_pending &= ~events;
+}
+
+bool host_gpio_level(uint gpio) {
+  return gpios[gpio].level;
+}
+
+void gpio_set_dormant_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+  if (enabled) gpios[gpio].dormant_events |= events;
+  else gpios[gpio].dormant_events &= ~events;
+}
+
+void host_gpio_edge(uint gpio, uint32_t events) {
+  if (power.dormant && (events & gpios[gpio].dormant_events)) power.woken = true;
+  events &= gpios[gpio].irq_events;
+  if (events == 0) return;
+  irq_depth++;
+  if (gpios[gpio].raw_handler != NULL) {
+    gpios[gpio].irq_pending |= events;
+    gpios[gpio].raw_handler();
+  } else if (gpio_callback != NULL) {
+    gpio_callback(gpio, events);
+  }
+  irq_depth--;
+}
+
+// ---------------------------------- IRQ ---------------------------------- //
+static irq_handler_t irq_handlers[32];
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+  irq_handlers[num & 31] = handler;
+}
+
+// ---------------------------------- ADC ---------------------------------- //
+#define ADC_CLOCK_HZ 48000000
+#define ADC_CONVERSION_CYCLES 96
+
+static uint16_t adc_values[5] = {2048, 2048, 2048, 0, 0};
+static uint16_t adc_noise = 0;
+static uint32_t adc_noise_state = 1;
+static uint adc_input = 0;
+static uint adc_round_robin = 0;
+static uint32_t adc_period_cycles = ADC_CONVERSION_CYCLES;
+static bool adc_running = false;
+adc_hw_t host_adc_hw;
+
+static void dma_adc_started(void);
+
+void adc_init(void) {}
+
+// One conversion of the selected input; round-robin mode then moves to the next enabled input
+static uint16_t adc_convert(void) {
+  int32_t value = adc_values[adc_input];
+  if (adc_noise) {
+    adc_noise_state = adc_noise_state * 1103515245u + 12345u;
+    value += (int32_t)((adc_noise_state >> 16) % (2u * adc_noise + 1)) - adc_noise;
+    value = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+  }
+  if (adc_round_robin) {
+    do {
+      adc_input = (adc_input + 1) % 5;
+    } while (!(adc_round_robin & (1u << adc_input)));
+  }
+  return (uint16_t)value;
+}
+
+void adc_set_round_robin(uint input_mask) {
+  adc_round_robin = input_mask & 0x1F;
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+  (void)en;
+  (void)dreq_en;
+  (void)dreq_thresh;
+  (void)err_in_fifo;
+  (void)byte_shift;
+}
+
+// A divider below one conversion time still yields back-to-back conversions
+void adc_set_clkdiv(float clkdiv) {
+  uint32_t cycles = (uint32_t)clkdiv + 1;
+  adc_period_cycles = cycles < ADC_CONVERSION_CYCLES ? ADC_CONVERSION_CYCLES : cycles;
+}
+
+void adc_run(bool run) {
+  adc_running = run;
+  if (run) dma_adc_started();
+}
+
+void host_adc_set_noise(uint16_t amplitude) {
+  adc_noise = amplitude;
+}
+
+void adc_gpio_init(uint gpio) {
+  gpios[gpio].function = GPIO_FUNC_NULL;
+}
+
+void adc_select_input(uint input) {
+  adc_input = input % 5;
+}
+
+uint16_t adc_read(void) {
+  sleep_us(2); // One conversion takes 96 ADC clocks at 48 MHz
+  return adc_convert();
+}
+
+void host_adc_set(uint input, uint16_t raw) {
+  adc_values[input % 5] = raw & 0x0FFF;
+}
+
+// ---------------------------------- DMA ---------------------------------- //
+// A channel paced by DREQ_ADC completes once the ADC has produced transfer_count
+// samples; the samples are then written, the chained channel starts, and the
+// DMA_IRQ_0 handler runs, all from one alarm.
+typedef struct {
+  bool claimed;
+  dma_channel_config config;
+  volatile void *write_addr;
+  uint32_t count;
+  bool busy;
+  bool irq0_enabled;
+  bool irq0_status;
+  alarm_id_t completion;
+} host_dma;
+
+static host_dma dmas[NUM_DMA_CHANNELS];
+
+static void dma_start(uint channel);
+
+static int64_t dma_complete(alarm_id_t id, void *user_data) {
+  (void)id;
+  uint channel = (uint)(uintptr_t)user_data;
+  host_dma *d = &dmas[channel];
+  d->completion = 0;
+  d->busy = false;
+
+  uint8_t *dst = (uint8_t *)d->write_addr;
+  uint size = 1u << d->config.size;
+  for (uint32_t i = 0; i < d->count; i++) {
+    uint32_t sample = adc_convert();
+    memcpy(dst, &sample, size);
+    if (d->config.write_increment) dst += size;
+  }
+  d->write_addr = dst;
+
+  if (d->config.chain_to != channel) dma_start(d->config.chain_to);
+  if (d->irq0_enabled) {
+    d->irq0_status = true;
+    if (irq_handlers[DMA_IRQ_0] != NULL) irq_handlers[DMA_IRQ_0]();
+  }
+  return 0;
+}
+
+static void dma_schedule(uint channel) {
+  host_dma *d = &dmas[channel];
+  if (!d->busy || d->completion != 0 || d->config.dreq != DREQ_ADC || !adc_running) return;
+  uint64_t cycles = (uint64_t)d->count * adc_period_cycles;
+  uint64_t us = (cycles + ADC_CLOCK_HZ / 1000000 - 1) / (ADC_CLOCK_HZ / 1000000);
+  d->completion = add_alarm_in_us(us, dma_complete, (void *)(uintptr_t)channel, true);
+}
+
+static void dma_start(uint channel) {
+  dmas[channel].busy = true;
+  dma_schedule(channel);
+}
+
+static void dma_adc_started(void) {
+  for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) dma_schedule(ch);
+}
+
+int dma_claim_unused_channel(bool required) {
+  for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+    if (!dmas[ch].claimed) {
+      dmas[ch].claimed = true;
+      return ch;
+    }
+  }
+  if (required) {
+    fprintf(stderr, "No DMA channels available\n");
+    abort();
+  }
+  return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+  return (dma_channel_config) {DMA_SIZE_32, true, false, 0x3F, channel};
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+  (void)read_addr;
+  dmas[channel].config = *config;
+  dmas[channel].write_addr = write_addr;
+  dmas[channel].count = transfer_count;
+  if (trigger) dma_start(channel);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+  dmas[channel].write_addr = write_addr;
+  if (trigger) dma_start(channel);
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+  dmas[channel].irq0_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+  return dmas[channel].irq0_status;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+  dmas[channel].irq0_status = false;
+}
+
+// ---------------------------------- PWM ---------------------------------- //
+#define PWM_SYS_CLOCK_HZ 125000000u
+
+static uint16_t pwm_levels[NUM_BANK0_GPIOS];
+
+static struct {
+  uint16_t div_q4;   // Clock divider, 8.4 fixed point
+  uint16_t wrap;
+  bool enabled;
+} pwm_slices[NUM_PWM_SLICES];
+
+void pwm_set_clkdiv(uint slice_num, float divider) {
+  pwm_slices[slice_num].div_q4 = (uint16_t)(divider * 16.0f);
+}
+
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract) {
+  pwm_slices[slice_num].div_q4 = (uint16_t)((integer << 4) | (fract & 0xF));
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+  pwm_slices[slice_num].wrap = wrap;
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+  // Both GPIOs sharing a slice/channel pair follow the same compare level
+  for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+    if (pwm_gpio_to_slice_num(gpio) == slice_num && pwm_gpio_to_channel(gpio) == chan) {
+      pwm_levels[gpio] = level;
+    }
+  }
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+  pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+  pwm_slices[slice_num].enabled = enabled;
+}
+
+uint16_t host_pwm_level(uint gpio) {
+  return pwm_levels[gpio];
+}
+
+uint32_t host_pwm_frequency(uint gpio) {
+  uint slice = pwm_gpio_to_slice_num(gpio);
+  if (!pwm_slices[slice].enabled || pwm_levels[gpio] == 0 || pwm_slices[slice].div_q4 == 0) return 0;
+  uint64_t period = (uint64_t)pwm_slices[slice].div_q4 * (pwm_slices[slice].wrap + 1u);
+  return (uint32_t)(((uint64_t)PWM_SYS_CLOCK_HZ * 16 + period / 2) / period);
+}
+
+// ---------------------------------- I2C ---------------------------------- //
+i2c_inst_t i2c0_inst = {100 * 1000};
+i2c_inst_t i2c1_inst = {100 * 1000};
+
+static host_i2c_stats i2c_stats[128];
+static host_i2c_observer i2c_observer = NULL;
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+  return i2c_set_baudrate(i2c, baudrate);
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+  i2c->baudrate = baudrate;
+  return baudrate;
+}
+
+// START + address + payload (9 clocks per byte with ACK) + STOP
+static void charge_wire_time(i2c_inst_t *i2c, uint8_t addr, size_t len) {
+  uint64_t bits = (len + 1) * 9 + 2;
+  uint64_t us = (bits * 1000000 + i2c->baudrate - 1) / i2c->baudrate;
+  i2c_stats[addr & 0x7F].busy_us += us;
+  sleep_us(us);
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+  (void)nostop;
+  host_i2c_stats *s = &i2c_stats[addr & 0x7F];
+  if (i2c_observer) i2c_observer(addr, len, false);
+  s->transactions++;
+  if (!host_dev_i2c_write(addr, src, len)) {
+    s->errors++;
+    charge_wire_time(i2c, addr, 0);
+    return PICO_ERROR_GENERIC;
+  }
+  s->bytes += len;
+  charge_wire_time(i2c, addr, len);
+  return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+  (void)nostop;
+  host_i2c_stats *s = &i2c_stats[addr & 0x7F];
+  if (i2c_observer) i2c_observer(addr, len, true);
+  s->transactions++;
+  if (!host_dev_i2c_read(addr, dst, len)) {
+    s->errors++;
+    charge_wire_time(i2c, addr, 0);
+    return PICO_ERROR_GENERIC;
+  }
+  s->bytes += len;
+  charge_wire_time(i2c, addr, len);
+  return (int)len;
+}
+
+host_i2c_stats host_i2c_get_stats(uint8_t addr) {
+  return i2c_stats[addr & 0x7F];
+}
+
+void host_i2c_reset_stats(void) {
+  memset(i2c_stats, 0, sizeof(i2c_stats));
+}
+
+void host_i2c_set_observer(host_i2c_observer observer) {
+  i2c_observer = observer;
+}
+
+// ---------------------------------- Flash ---------------------------------- //
+// Typical W25Q16JV timings
+#define HOST_FLASH_ERASE_US   45000 // 4 KB sector erase
+#define HOST_FLASH_PROGRAM_US   400 // 256-byte page program
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+static host_flash_stats flash_stats;
+
+__attribute__((constructor)) static void flash_blank(void) {
+  memset(host_flash, 0xFF, sizeof(host_flash)); // A fresh chip reads erased
+}
+
+// Interrupts are off and core 1 is locked out: alarms due meanwhile fire late, core 1 catches up after
+static void flash_busy(uint64_t us) {
+  flash_stats.busy_us += us;
+  irq_depth++;
+  run_until(now_us + us);
+  irq_depth--;
+}
+
+static void flash_check(uint32_t offs, size_t count, uint32_t unit, const char *what) {
+  if (offs % unit || count % unit || offs + count > PICO_FLASH_SIZE_BYTES) {
+    fprintf(stderr, "host: %s of %zu bytes at 0x%x is not aligned to %u or out of range\n", what, count, offs, unit);
+    abort();
+  }
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  flash_check(flash_offs, count, FLASH_SECTOR_SIZE, "erase");
+  memset(host_flash + flash_offs, 0xFF, count);
+  flash_stats.erases += count / FLASH_SECTOR_SIZE;
+  flash_busy(count / FLASH_SECTOR_SIZE * HOST_FLASH_ERASE_US);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  flash_check(flash_offs, count, FLASH_PAGE_SIZE, "program");
+  for (size_t i = 0; i < count; i++) host_flash[flash_offs + i] &= data[i]; // Programming only clears bits
+  flash_stats.programs += count / FLASH_PAGE_SIZE;
+  flash_busy(count / FLASH_PAGE_SIZE * HOST_FLASH_PROGRAM_US);
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms) {
+  (void)enter_exit_timeout_ms;
+  func(param);
+  return PICO_OK;
+}
+
+host_flash_stats host_flash_get_stats(void) {
+  return flash_stats;
+}
+
+bool host_flash_load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return false;
+  bool ok = fread(host_flash, 1, sizeof(host_flash), f) == sizeof(host_flash);
+  fclose(f);
+  return ok;
+}
+
+bool host_flash_save(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) return false;
+  bool ok = fwrite(host_flash, 1, sizeof(host_flash), f) == sizeof(host_flash);
+  return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,115 @@
+// host_hal.h
+// Host-side control of the Pico SDK shim used to build the firmware on Linux.
+// Includes:
+// - A virtual clock: sleeps advance time instantly, alarms fire in order
+// - Core 1 as a coroutine with its own clock, kept behind core 0's
+// - Device models for the LCD (PCF8574 + HD44780), DS1307 RTC, DHT22,
+//   potentiometers and the NEC IR receiver
+// - Per-address I2C bus statistics
+// - A supply current model driven by the clock source and the LCD backlight
+// - The QSPI flash as an in-memory image that can be saved between runs
+//
+// Every call to time_us_64() costs HOST_POLL_COST_US of virtual time so that
+// busy-wait loops in the firmware still see the clock moving.
+
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HOST_POLL_COST_US 1
+
+// ---------------------------------- Virtual Clock ---------------------------------- //
+uint64_t host_now_us(void);            // Reads the clock without charging the poll cost
+void host_advance_us(uint64_t us);     // Moves the clock forward, firing due alarms on the way
+bool host_in_irq(void);                // True while an alarm or GPIO callback is running
+
+// ---------------------------------- GPIO / PWM Inspection ---------------------------------- //
+bool host_gpio_level(unsigned int gpio);                  // Last level driven on an output pin
+uint16_t host_pwm_level(unsigned int gpio);               // Current PWM compare level of a pin
+uint32_t host_pwm_frequency(unsigned int gpio);           // Output frequency in Hz, 0 while silent
+void host_gpio_edge(unsigned int gpio, uint32_t events);  // Raises a GPIO interrupt as the hardware would
+
+// ---------------------------------- Device Models ---------------------------------- //
+// Potentiometers (raw 12-bit value per ADC input, plus uniform noise of +/- amplitude counts)
+void host_adc_set(unsigned int input, uint16_t raw);
+void host_adc_set_noise(uint16_t amplitude);
+
+// DS1307 RTC: sets the calendar time seen at the current virtual instant
+void host_rtc_set(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
+uint32_t host_rtc_reads(void);         // Number of register reads served so far
+
+// DHT22: pin to emulate, values returned, and whether the sensor answers at all
+void host_dht_attach(unsigned int gpio);
+void host_dht_set(float temp_celsius, float humidity);
+void host_dht_set_responding(bool responding);
+uint32_t host_dht_reads(void);         // Number of start pulses answered
+
+// DS1307 square wave: falling edges on gpio while the control register selects 1 Hz (SQWE, RS = 00)
+void host_rtc_attach_sqw(unsigned int gpio);
+
+// NEC IR receiver: schedules the falling edges of a frame on the attached pin
+void host_ir_attach(unsigned int gpio);
+uint64_t host_ir_press_at(uint64_t at_us, uint8_t address, uint8_t command); // Returns when the last edge falls
+void host_ir_repeat_at(uint64_t at_us);
+
+// LCD: copies one row of the emulated display (LCD_COLS chars + terminator)
+void host_lcd_row(int row, char *out, size_t size);
+void host_lcd_dump(void);              // Prints the four rows to stdout
+bool host_lcd_backlight(void);         // Backlight bit of the last expander write
+
+// ---------------------------------- I2C Statistics ---------------------------------- //
+typedef struct {
+  uint32_t transactions;  // START..STOP sequences addressed to the device
+  uint32_t bytes;         // Payload bytes, excluding the address byte
+  uint32_t errors;        // Transactions that were not acknowledged
+  uint64_t busy_us;       // Virtual time spent on the wire
+} host_i2c_stats;
+
+host_i2c_stats host_i2c_get_stats(uint8_t addr);
+void host_i2c_reset_stats(void);
+
+// Called at the start of every transaction, on the core that issues it (host_now_us() is that core's clock)
+typedef void (*host_i2c_observer)(uint8_t addr, size_t len, bool read);
+void host_i2c_set_observer(host_i2c_observer observer); // NULL removes it
+
+// ---------------------------------- Power ---------------------------------- //
+typedef enum {
+  HOST_CLOCK_PLL,     // Normal run: clocks_init()
+  HOST_CLOCK_XOSC,    // sleep_run_from_xosc()
+  HOST_CLOCK_DORMANT, // Inside xosc_dormant()
+  HOST_CLOCK_MODES
+} host_clock_mode;
+
+// Running totals since boot; the average between two snapshots uses typical currents (host_hal.c)
+typedef struct {
+  uint64_t mode_us[HOST_CLOCK_MODES]; // Virtual time spent on each clock source
+  uint64_t backlight_us;              // Virtual time with the LCD backlight lit
+  uint32_t dormant_entries;
+} host_power_stats;
+
+host_power_stats host_power_get_stats(void);
+double host_power_average_ma(const host_power_stats *from, const host_power_stats *to);
+
+// ---------------------------------- Flash ---------------------------------- //
+typedef struct {
+  uint32_t erases;    // Sectors erased
+  uint32_t programs;  // Pages programmed
+  uint64_t busy_us;   // Virtual time with interrupts off for flash operations
+} host_flash_stats;
+
+host_flash_stats host_flash_get_stats(void);
+bool host_flash_load(const char *path); // Whole image; a fresh chip reads 0xFF
+bool host_flash_save(const char *path); // Keeps the image for the next run (a power cycle)
+
+// ---------------------------------- Shim Internals ---------------------------------- //
+// Used between host_hal.c and host_devices.c only.
+bool host_dev_i2c_write(uint8_t addr, const uint8_t *src, size_t len);
+bool host_dev_i2c_read(uint8_t addr, uint8_t *dst, size_t len);
+void host_dev_gpio_dir_changed(unsigned int gpio, bool out, bool level);
+bool host_dev_gpio_input(unsigned int gpio, bool *level);
+uint64_t host_dev_lcd_backlight_us(void);
+
+#endif // HOST_HAL_H
@@ -0,0 +1,11 @@
+// pico/flash.h (host shim)
+
+#ifndef PICO_FLASH_H
+#define PICO_FLASH_H
+
+#include <stdint.h>
+
+// Runs func with the other core locked out and interrupts off; PICO_OK when it ran
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+#endif // PICO_FLASH_H
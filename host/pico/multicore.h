@@ -0,0 +1,10 @@
+// pico/multicore.h (host shim)
+// Core 1 runs as a coroutine on the virtual clock, see host_hal.c.
+
+#ifndef PICO_MULTICORE_H
+#define PICO_MULTICORE_H
+
+void multicore_launch_core1(void (*entry)(void));
+static inline void multicore_lockout_victim_init(void) {} // The shim stalls core 1 itself (flash.h)
+
+#endif // PICO_MULTICORE_H
@@ -0,0 +1,11 @@
+// pico/sleep.h (host shim)
+// Stand-in for the pico-extras sleep library: only the clock source is tracked,
+// for the current model in host_hal.h.
+
+#ifndef PICO_SLEEP_H
+#define PICO_SLEEP_H
+
+void sleep_run_from_xosc(void); // clk_sys and clk_peri from the 12 MHz crystal, PLLs off
+void sleep_power_up(void);      // Undoes the clock gating of a sleep; clocks_init() restores the PLLs
+
+#endif // PICO_SLEEP_H
@@ -0,0 +1,25 @@
+// pico/stdlib.h (host shim)
+// Linux stand-in for the Pico SDK umbrella header, used by the host build.
+// Time is virtual: see host_hal.h.
+
+#ifndef PICO_STDLIB_H
+#define PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -2
+
+bool stdio_init_all(void);
+uint get_core_num(void);
+
+#endif // PICO_STDLIB_H
@@ -0,0 +1,42 @@
+// pico/sync.h (host shim)
+// Both cores share one host thread: a core that finds the mutex taken waits
+// for an event (WFE), which lets the other core run on until it releases it.
+
+#ifndef PICO_SYNC_H
+#define PICO_SYNC_H
+
+#include <stdbool.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+typedef struct {
+  bool owned;
+  unsigned int owner; // Core holding the mutex
+} mutex_t;
+
+static inline void mutex_init(mutex_t *mtx) { mtx->owned = false; }
+static inline bool mutex_try_enter(mutex_t *mtx, unsigned int *owner_out) {
+  if (mtx->owned) {
+    if (owner_out) *owner_out = mtx->owner;
+    return false;
+  }
+  mtx->owned = true;
+  mtx->owner = get_core_num();
+  return true;
+}
+static inline void mutex_enter_blocking(mutex_t *mtx) {
+  while (!mutex_try_enter(mtx, NULL)) {
+    assert(mtx->owner != get_core_num()); // Not recursive
+    __wfe();
+  }
+}
+static inline void mutex_exit(mutex_t *mtx) {
+  assert(mtx->owned && mtx->owner == get_core_num());
+  mtx->owned = false;
+  __sev();
+}
+
+#define auto_init_mutex(name) static mutex_t name = {false, 0}
+
+#endif // PICO_SYNC_H
@@ -0,0 +1,49 @@
+// pico/time.h (host shim)
+// Absolute time, sleeps and alarms on top of the virtual clock in host_hal.c.
+
+#ifndef PICO_TIME_H
+#define PICO_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware/timer.h"
+
+typedef uint64_t absolute_time_t;
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + (uint64_t)ms * 1000; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + (uint64_t)ms * 1000; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+static inline bool is_nil_time(absolute_time_t t) { return t == 0; }
+
+#define nil_time ((absolute_time_t)0)
+#define at_the_end_of_time ((absolute_time_t)INT64_MAX)
+
+static inline bool is_at_the_end_of_time(absolute_time_t t) { return t == at_the_end_of_time; }
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void sleep_until(absolute_time_t target);
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+// Alarms (fired from the virtual clock as if from the timer IRQ)
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+static inline alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+  return add_alarm_at(make_timeout_time_us(us), callback, user_data, fire_if_past);
+}
+
+static inline alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+  return add_alarm_at(make_timeout_time_ms(ms), callback, user_data, fire_if_past);
+}
+
+#endif // PICO_TIME_H
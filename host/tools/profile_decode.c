@@ -0,0 +1,157 @@
+// profile_decode.c
+// Host decoder for profile_dump() output: reads a stdio capture (other lines are
+// ignored), takes the last complete dump and prints per-span timing, brew stage
+// latency and the counters with their rates.
+//
+// Build and use:
+//   gcc -std=gnu11 -O2 -Ihost -Isrc/profiling host/tools/profile_decode.c -o profile_decode
+//   ./profile_decode < capture.txt
+
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DUMP_BYTES (PROFILE_HEADER_BYTES + 255 * 4 + PROFILE_CORES * PROFILE_RING_SIZE * PROFILE_RECORD_BYTES)
+#define MAX_LINE 512
+
+// Same order as BrewStageId in internal_operations.c
+static const char *stage_names[] = {
+  "resources", "start", "heating", "beans", "grinding", "extraction", "release", "finish"
+};
+#define STAGE_NAME_COUNT (sizeof(stage_names) / sizeof(stage_names[0]))
+
+static const char *span_names[] = PROFILE_SPAN_NAMES;
+static const char *counter_names[] = PROFILE_COUNTER_NAMES;
+
+typedef struct {
+  uint32_t count;
+  uint64_t total;
+  uint32_t min;
+  uint32_t max;
+} span_stats;
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+  return value;
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static void add_sample(span_stats *s, uint32_t duration_us) {
+  if (s->count == 0 || duration_us < s->min) s->min = duration_us;
+  if (duration_us > s->max) s->max = duration_us;
+  s->total += duration_us;
+  s->count++;
+}
+
+static void print_stats(const char *name, const span_stats *s, double scale, const char *unit) {
+  if (s->count == 0) return;
+  printf("  %-18s %7u %12.3f %10.1f %10.1f %10.1f  %s\n", name, s->count, s->total / 1e3,
+         s->min / scale, s->total / scale / s->count, s->max / scale, unit);
+}
+
+// Collects the bytes of the last complete, checked dump; returns its length or -1
+static long read_last_dump(FILE *in, uint8_t *dump) {
+  static uint8_t pending[MAX_DUMP_BYTES];
+  char line[MAX_LINE];
+  long expected = -1, fill = 0, found = -1;
+
+  while (fgets(line, sizeof(line), in)) {
+    unsigned value;
+    if (sscanf(line, "#PROFILE BEGIN %u", &value) == 1) {
+      expected = value <= MAX_DUMP_BYTES ? (long)value : -1;
+      fill = 0;
+    } else if (expected >= 0 && strncmp(line, "#P ", 3) == 0) {
+      for (char *c = line + 3; hex_value(c[0]) >= 0 && hex_value(c[1]) >= 0; c += 2) {
+        if (fill == expected) break;
+        pending[fill++] = (uint8_t)(hex_value(c[0]) << 4 | hex_value(c[1]));
+      }
+    } else if (expected >= 0 && sscanf(line, "#PROFILE END %x", &value) == 1) {
+      uint16_t sum = 0;
+      for (long i = 0; i < fill; i++) sum += pending[i];
+      if (fill == expected && sum == value) {
+        memcpy(dump, pending, fill);
+        found = fill;
+      } else {
+        fprintf(stderr, "skipping a damaged dump (%ld of %ld bytes)\n", fill, expected);
+      }
+      expected = -1;
+    }
+  }
+  return found;
+}
+
+int main(void) {
+  static uint8_t dump[MAX_DUMP_BYTES];
+  long length = read_last_dump(stdin, dump);
+  if (length < PROFILE_HEADER_BYTES || memcmp(dump, "PROF", 4) != 0) {
+    fprintf(stderr, "no profile dump found\n");
+    return 1;
+  }
+  if (dump[4] != PROFILE_FORMAT_VERSION) {
+    fprintf(stderr, "unsupported format version %u\n", dump[4]);
+    return 1;
+  }
+
+  uint8_t counter_count = dump[6];
+  uint64_t now_us = get_le(dump + 8, 8);
+  uint64_t since_us = get_le(dump + 16, 8);
+  uint32_t dropped = get_le(dump + 24, 4);
+  uint16_t records = get_le(dump + 28, 2);
+  const uint8_t *counters = dump + PROFILE_HEADER_BYTES;
+  const uint8_t *record = counters + counter_count * 4;
+  if (record + (long)records * PROFILE_RECORD_BYTES > dump + length) {
+    fprintf(stderr, "truncated dump\n");
+    return 1;
+  }
+
+  span_stats spans[PROFILE_SPAN_COUNT] = {0};
+  span_stats stages[STAGE_NAME_COUNT] = {0};
+  span_stats lcd_bytes = {0};
+  uint32_t oldest_age_us = 0;
+
+  for (int i = 0; i < records; i++, record += PROFILE_RECORD_BYTES) {
+    uint32_t start = get_le(record, 4);
+    uint32_t duration = get_le(record + 4, 4);
+    uint8_t span = record[8];
+    uint16_t arg = get_le(record + 10, 2);
+    uint32_t age = (uint32_t)now_us - start; // Timestamps are the low 32 bits
+    if (age > oldest_age_us) oldest_age_us = age;
+
+    if (span >= PROFILE_SPAN_COUNT) continue;
+    add_sample(&spans[span], duration);
+    if (span == PROFILE_SPAN_BREW_STAGE && arg < STAGE_NAME_COUNT) add_sample(&stages[arg], duration);
+    if (span == PROFILE_SPAN_LCD_FLUSH) add_sample(&lcd_bytes, arg);
+  }
+
+  printf("profile at %.3f s: %u records over the last %.3f s, %u dropped\n",
+         now_us / 1e6, records, oldest_age_us / 1e6, dropped);
+  printf("  %-18s %7s %12s %10s %10s %10s\n", "span", "count", "total ms", "min", "avg", "max");
+  for (int i = 0; i < PROFILE_SPAN_COUNT; i++) {
+    print_stats(span_names[i], &spans[i], 1.0, "us");
+  }
+  printf("brew stage latency\n");
+  for (unsigned i = 0; i < STAGE_NAME_COUNT; i++) {
+    print_stats(stage_names[i], &stages[i], 1e3, "ms");
+  }
+  if (lcd_bytes.count) {
+    printf("lcd flush size: %.1f expander bytes on average, %u at most\n",
+           (double)lcd_bytes.total / lcd_bytes.count, lcd_bytes.max);
+  }
+
+  double window_s = (now_us - since_us) / 1e6;
+  printf("counters over %.3f s\n", window_s);
+  for (int i = 0; i < counter_count; i++) {
+    uint32_t value = get_le(counters + i * 4, 4);
+    const char *name = i < PROFILE_COUNTER_COUNT ? counter_names[i] : "unknown";
+    printf("  %-18s %10u  %10.1f /s\n", name, value, window_s > 0 ? value / window_s : 0.0);
+  }
+  return 0;
+}
@@ -1,11 +1,13 @@
 // actuators.c
 // Includes control for LEDs, servomotors, stepper motor, and buzzer
 
-#include <math.h>  // For using fmax
+#include <math.h>  // For sqrtf
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include "actuators.h"
+#include "profile.h"
 
 #define GREEN_LED 7          // Green LED: indicates that the system is on
 #define RED_LED 12           // Red LED: indicates that the machine needs refilling
@@ -38,38 +40,266 @@ void init_leds() {
   gpio_put(RED_LED, 0);
 }
 
+/* The bar is one SIO mask: lighting the first n LEDs is a single
+   gpio_put_masked() with a precomputed mask rather than ten gpio_put() calls.
+   Fill, blink and breathe are ticked by one timer alarm, so the strength
+   indicator keeps animating while the brew goes on; a new effect replaces the
+   running one. Breathing hands the lit pins to PWM. Pin 15 shares slice 7 with
+   the buzzer, which also wraps at 4095, so the LED duty holds whatever tone
+   the buzzer sets the divider to. */
+#define LED_BAR_COUNT 10
+#define LED_BAR_WRAP 4095
+#define LED_BAR_FILL_MS 200
+#define LED_BAR_BREATHE_MS 2000  // One breath
+#define LED_BAR_FRAME_MS 20      // Brightness update while breathing
+
+typedef enum {
+  LED_BAR_IDLE,
+  LED_BAR_FILL,
+  LED_BAR_BLINK,
+  LED_BAR_BREATHE
+} led_bar_effect;
+
+static uint32_t led_bar_masks[LED_BAR_COUNT + 1]; // Pins of the first n LEDs
+
+static struct {
+  led_bar_effect effect;
+  uint8_t lit;            // LEDs on (or breathing)
+  uint8_t target;         // Fill: where to stop
+  uint16_t toggles;       // Blink: changes left
+  uint16_t interval_ms;
+  uint32_t t_ms;          // Breathe: time into the breath
+  bool pwm;               // Lit pins are on PWM rather than SIO
+  alarm_id_t alarm;
+} led_bar;
+
+static void led_bar_show(uint count) {
+  gpio_put_masked(led_bar_masks[LED_BAR_COUNT], led_bar_masks[count]);
+}
+
+static void led_bar_use_pwm(bool pwm) {
+  if (led_bar.pwm == pwm) return;
+  for (int i = 0; i < led_bar.lit; i++) {
+    gpio_set_function(LED_BAR_PINS[i], pwm ? GPIO_FUNC_PWM : GPIO_FUNC_SIO);
+  }
+  led_bar.pwm = pwm;
+}
+
+// Triangle wave squared, so the fade looks even to the eye; never fully dark
+static uint16_t led_bar_brightness(uint32_t t_ms) {
+  uint32_t half = LED_BAR_BREATHE_MS / 2;
+  uint32_t tri = (t_ms < half ? t_ms : LED_BAR_BREATHE_MS - t_ms) * 256 / half; // Q8
+  uint32_t floor_level = LED_BAR_WRAP / 16;
+  return floor_level + ((tri * tri * (LED_BAR_WRAP - floor_level)) >> 16);
+}
+
+static void led_bar_breathe_frame() {
+  uint16_t level = led_bar_brightness(led_bar.t_ms);
+  for (int i = 0; i < led_bar.lit; i++) {
+    pwm_set_gpio_level(LED_BAR_PINS[i], level);
+  }
+  led_bar.t_ms = (led_bar.t_ms + LED_BAR_FRAME_MS) % LED_BAR_BREATHE_MS;
+}
+
+static void led_bar_start_breathing() {
+  for (int i = 0; i < led_bar.lit; i++) {
+    uint slice_num = pwm_gpio_to_slice_num(LED_BAR_PINS[i]);
+    pwm_set_wrap(slice_num, LED_BAR_WRAP);
+    pwm_set_enabled(slice_num, true);
+  }
+  led_bar.t_ms = 0;
+  led_bar_breathe_frame();
+  led_bar_use_pwm(true);
+  led_bar.effect = LED_BAR_BREATHE;
+}
+
+static int64_t led_bar_tick(alarm_id_t id, void *user_data) {
+  switch (led_bar.effect) {
+    case LED_BAR_FILL:
+      if (led_bar.lit < led_bar.target) led_bar_show(++led_bar.lit); // A bar of one is already full
+      if (led_bar.lit < led_bar.target) return (int64_t)led_bar.interval_ms * 1000;
+      led_bar_start_breathing();
+      return LED_BAR_FRAME_MS * 1000;
+
+    case LED_BAR_BLINK:
+      led_bar_show((--led_bar.toggles & 1) ? LED_BAR_COUNT : 0);
+      if (led_bar.toggles > 0) return (int64_t)led_bar.interval_ms * 1000;
+      led_bar.lit = 0;
+      break;
+
+    case LED_BAR_BREATHE:
+      led_bar_breathe_frame();
+      return LED_BAR_FRAME_MS * 1000;
+
+    default:
+      break;
+  }
+  led_bar.effect = LED_BAR_IDLE;
+  led_bar.alarm = 0;
+  return 0;
+}
+
+// Ends the running effect and leaves the LEDs it had lit steadily on
+void led_bar_stop(void) {
+  if (led_bar.alarm > 0) {
+    cancel_alarm(led_bar.alarm);
+  }
+  led_bar.alarm = 0;
+  led_bar.effect = LED_BAR_IDLE;
+  led_bar_use_pwm(false);
+  led_bar_show(led_bar.lit);
+}
+
+bool led_bar_busy(void) {
+  return led_bar.effect != LED_BAR_IDLE;
+}
+
 void init_led_bar() {
-  for (int i = 0; i < 10; i++) {
+  for (int i = 0; i < LED_BAR_COUNT; i++) {
     gpio_init(LED_BAR_PINS[i]);
     gpio_set_dir(LED_BAR_PINS[i], GPIO_OUT);
-    gpio_put(LED_BAR_PINS[i], 0);
+    led_bar_masks[i + 1] = led_bar_masks[i] | (1u << LED_BAR_PINS[i]);
   }
+  led_bar_show(0);
 }
 
 void blink_led_bar(int times, int interval_ms) {
-  for (int i = 0; i < times; i++) {
-    for (int j = 0; j < 10; j++) {
-      gpio_put(LED_BAR_PINS[j], 1);
-    }
-    sleep_ms(interval_ms);
+  led_bar_stop();
+  if (times <= 0) return;
+  led_bar.lit = LED_BAR_COUNT;
+  led_bar_show(LED_BAR_COUNT);
+  led_bar.toggles = times * 2 - 1; // Ends dark
+  led_bar.interval_ms = interval_ms;
+  led_bar.effect = LED_BAR_BLINK;
+  led_bar.alarm = add_alarm_in_ms(interval_ms, led_bar_tick, NULL, true);
+}
+
+void update_led_bar(int pressure) {
+  led_bar_stop();
+  int num_leds = (pressure * LED_BAR_COUNT) / 100;
+  if (num_leds < 1) num_leds = 1;
+  if (num_leds > LED_BAR_COUNT) num_leds = LED_BAR_COUNT;
+
+  led_bar.lit = 1;
+  led_bar_show(1);
+  led_bar.target = num_leds;
+  led_bar.interval_ms = LED_BAR_FILL_MS;
+  led_bar.effect = LED_BAR_FILL;
+  led_bar.alarm = add_alarm_in_ms(num_leds > 1 ? LED_BAR_FILL_MS : 0, led_bar_tick, NULL, true);
+}
+
+// -------------------------------------------------------------------------------------------------- //
+// Servomotors
 
-    for (int j = 0; j < 10; j++) {
-      gpio_put(LED_BAR_PINS[j], 0);
+/* Timer-driven motion engine: one repeating alarm, one tick per 50 Hz PWM frame
+   (a new compare level only takes effect at the next frame anyway), advances
+   every servo that is playing a path. Each move eases in and out with an integer
+   smoothstep, s = p^2 (3 - 2p) in Q8, interpolated in PWM counts rather than
+   whole degrees. The alarm stops once no servo is moving. */
+#define SERVO_COUNT 2
+#define SERVO_FRAME_MS 20
+
+typedef struct {
+  const servo_waypoint *path;
+  uint8_t count;
+  uint8_t next;              // Waypoint being played
+  uint16_t from;             // Pulse width when the current move started
+  uint16_t level;            // Pulse width being output
+  uint32_t t_ms;             // Time into the current waypoint
+  volatile bool busy;
+  servo_done_callback on_done;
+} servo_motion;
+
+static const uint servo_pins[SERVO_COUNT] = {SERVO1_PIN, SERVO2_PIN};
+static servo_motion servos[SERVO_COUNT];
+static alarm_id_t servo_alarm = 0;
+
+static uint16_t servo_pulse(uint angle) {
+  if (angle > 180) angle = 180;
+  return 870 + (angle * 2000 / 180);
+}
+
+// Level for the current instant; moves on to the next waypoint once this one (move + hold) is over
+static void servo_advance(uint index) {
+  servo_motion *m = &servos[index];
+  while (m->busy) {
+    const servo_waypoint *w = &m->path[m->next];
+    uint16_t target = servo_pulse(w->angle);
+    if (m->t_ms < w->move_ms) {
+      uint32_t p = (m->t_ms << 8) / w->move_ms;    // Progress, Q8
+      uint32_t s = (p * p * (768 - 2 * p)) >> 16;  // Smoothstep, Q8
+      m->level = m->from + ((int32_t)(target - m->from) * (int32_t)s) / 256;
+      break;
+    }
+    m->level = target;
+    if (m->t_ms < (uint32_t)w->move_ms + w->hold_ms) break;
+
+    m->t_ms -= w->move_ms + w->hold_ms; // The leftover counts towards the next waypoint
+    m->from = target;
+    if (++m->next == m->count) {
+      m->busy = false;
+      if (m->on_done) m->on_done(index + 1);
     }
-    sleep_ms(interval_ms);
   }
+  pwm_set_gpio_level(servo_pins[index], m->level);
 }
 
-void update_led_bar(int pressure) {
-  int num_leds = (int)fmax(1, (pressure * 10) / 100);
-  for (int i = 0; i < 10; i++) {
-    gpio_put(LED_BAR_PINS[i], (i < num_leds) ? 1 : 0);
-    sleep_ms(200);
+static int64_t servo_tick(alarm_id_t id, void *user_data) {
+  bool moving = false;
+  profile_count(PROFILE_COUNT_SERVO_FRAMES, 1);
+  for (uint i = 0; i < SERVO_COUNT; i++) {
+    if (!servos[i].busy) continue;
+    servo_advance(i);
+    servos[i].t_ms += SERVO_FRAME_MS;
+    moving |= servos[i].busy;
   }
+  if (!moving) {
+    servo_alarm = 0;
+    return 0;
+  }
+  return SERVO_FRAME_MS * 1000;
 }
 
-// -------------------------------------------------------------------------------------------------- //
-// Servomotors
+// A new path replaces the one in progress and starts from wherever the servo is
+void servo_play(uint servo, const servo_waypoint *path, uint count, servo_done_callback on_done) {
+  uint index = servo - 1;
+  uint32_t irq = save_and_disable_interrupts();
+  servo_motion *m = &servos[index];
+  m->busy = false;
+  if (count > 0) {
+    m->path = path;
+    m->count = count;
+    m->next = 0;
+    m->from = m->level != 0 ? m->level : servo_pulse(path[0].angle); // Never positioned: start there
+    m->t_ms = 0;
+    m->on_done = on_done;
+    m->busy = true;
+  }
+  restore_interrupts(irq);
+
+  if (count == 0) {
+    if (on_done) on_done(servo);
+    return;
+  }
+  if (servo_alarm == 0) {
+    servo_alarm = add_alarm_in_us(0, servo_tick, NULL, true);
+  }
+}
+
+bool servo_busy(uint servo) {
+  return servos[servo - 1].busy;
+}
+
+void servo_stop(uint servo) {
+  servos[servo - 1].busy = false;
+}
+
+// Jumps straight to an angle, cancelling any path
+static void servo_set(uint index, uint angle) {
+  servos[index].busy = false;
+  servos[index].level = servo_pulse(angle);
+  pwm_set_gpio_level(servo_pins[index], servos[index].level);
+}
 
 void servo_init(void) {
   gpio_set_function(SERVO1_PIN, GPIO_FUNC_PWM);
@@ -88,37 +318,31 @@ void servo_init(void) {
 }
 
 void servo1_move(uint angle) {
-  if (angle > 180) angle = 180;
-  uint pulse_width = 870 + (angle * 2000 / 180);
-  pwm_set_gpio_level(SERVO1_PIN, pulse_width);
+  servo_set(0, angle);
 }
 
 void servo2_move(uint angle) {
-  if (angle > 180) angle = 180;
-  uint pulse_width = 870 + (angle * 2000 / 180);
-  pwm_set_gpio_level(SERVO2_PIN, pulse_width);
+  servo_set(1, angle);
+}
+
+// Blocking gate cycles, kept for simple callers
+static const servo_waypoint gate_cycle[] = {{90, 300, 400}, {180, 300, 400}, {0, 500, 0}};
+
+static void servo_wait(uint servo) {
+  while (servo_busy(servo)) {
+    __wfe(); // Woken up by the frame alarm
+  }
 }
 
 void servo1_motion(void) {
-  servo1_move(0);
   servo2_move(0);
-  sleep_ms(500);
-
-  servo1_move(90);
-  sleep_ms(1000);
-  servo1_move(180);
-  sleep_ms(1000);
-  servo1_move(0);
-  sleep_ms(100);
+  servo_play(SERVO_BEAN_GATE, gate_cycle, 3, NULL);
+  servo_wait(SERVO_BEAN_GATE);
 }
 
 void servo2_motion(void) {
-  servo2_move(90);
-  sleep_ms(1000);
-  servo2_move(180);
-  sleep_ms(1000);
-  servo2_move(0);
-  sleep_ms(100);
+  servo_play(SERVO_COFFEE_GATE, gate_cycle, 3, NULL);
+  servo_wait(SERVO_COFFEE_GATE);
 }
 
 // -------------------------------------------------------------------------------------------------- //
@@ -134,74 +358,287 @@ void stepper_init(void) {
   gpio_put(DIR_PIN, 0);
 }
 
-void stepper_rotate(bool direction, uint32_t duration_ms, uint32_t step_delay_ms) {
-  gpio_put(DIR_PIN, direction);
-  uint32_t steps = duration_ms / step_delay_ms;
-  for (uint32_t i = 0; i < steps; i++) {
-    gpio_put(STEP_PIN, 1);
-    sleep_ms(step_delay_ms / 2);
+/* Alarm-driven pulse engine: a hardware alarm toggles STEP with microsecond
+   timing while the CPU does other work. Moves follow a trapezoidal speed
+   profile (AVR446 integer recurrence): each step's period during the ramps is
+   c(n) = c(n-1) - 2 c(n-1) / (4n + 1), kept in Q8 microseconds. Every alarm
+   returns a negative delay, which re-arms relative to its own deadline rather
+   than to when the callback returns, so interrupt latency never accumulates
+   into the step rate. */
+#define STEPPER_PULSE_US 10 // STEP high time (A4988 needs at least 1 us)
+
+static struct {
+  volatile bool busy;
+  bool step_high;
+  uint32_t total_steps;
+  uint32_t done_steps;
+  uint32_t ramp_steps;       // Steps spent accelerating (and decelerating)
+  uint32_t c0_q8;            // First step period
+  uint32_t cmin_q8;          // Period at full speed
+  uint32_t c_q8;             // Current step period
+  alarm_id_t alarm;
+  stepper_done_callback on_done;
+} stepper;
+
+// Period of the step about to start, in microseconds
+static uint32_t stepper_next_period() {
+  uint32_t i = stepper.done_steps;
+  uint32_t remaining = stepper.total_steps - i;
+
+  if (stepper.ramp_steps == 0) {
+    stepper.c_q8 = stepper.cmin_q8;
+  } else if (i == 0) {
+    stepper.c_q8 = stepper.c0_q8;
+  } else if (remaining <= stepper.ramp_steps) {
+    stepper.c_q8 += (2 * stepper.c_q8) / (4 * remaining - 1);             // Decelerating
+  } else if (i < stepper.ramp_steps) {
+    stepper.c_q8 -= (2 * stepper.c_q8) / (4 * i + 1);                     // Accelerating
+    if (stepper.c_q8 < stepper.cmin_q8) stepper.c_q8 = stepper.cmin_q8;
+  } else {
+    stepper.c_q8 = stepper.cmin_q8;                                        // Cruising
+  }
+
+  uint32_t period = stepper.c_q8 >> 8;
+  return (period > 2 * STEPPER_PULSE_US) ? period : 2 * STEPPER_PULSE_US;
+}
+
+static uint32_t stepper_period_us = 0;
+
+static int64_t stepper_alarm(alarm_id_t id, void *user_data) {
+  if (stepper.step_high) { // End of the pulse
     gpio_put(STEP_PIN, 0);
-    sleep_ms(step_delay_ms / 2);
+    stepper.step_high = false;
+    if (++stepper.done_steps >= stepper.total_steps) {
+      stepper.busy = false;
+      stepper.alarm = 0;
+      if (stepper.on_done) stepper.on_done();
+      return 0;
+    }
+    return -(int64_t)(stepper_period_us - STEPPER_PULSE_US);
+  }
+
+  stepper_period_us = stepper_next_period();
+  gpio_put(STEP_PIN, 1);
+  profile_count(PROFILE_COUNT_STEPPER_STEPS, 1);
+  stepper.step_high = true;
+  return -STEPPER_PULSE_US;
+}
+
+// Starts a move of `steps` steps, ramping up to max_speed (steps/s) with accel (steps/s^2).
+// accel = 0 runs the whole move at max_speed. on_done runs in interrupt context when the
+// last step has been emitted and must stay short (e.g. post an event).
+void stepper_move(bool direction, uint32_t steps, uint32_t max_speed, uint32_t accel, stepper_done_callback on_done) {
+  stepper_stop();
+  if (steps == 0 || max_speed == 0) {
+    if (on_done) on_done();
+    return;
+  }
+
+  gpio_put(DIR_PIN, direction);
+  stepper.total_steps = steps;
+  stepper.done_steps = 0;
+  stepper.step_high = false;
+  stepper.on_done = on_done;
+  stepper.cmin_q8 = (1000000u << 8) / max_speed;
+
+  if (accel > 0) {
+    // c0 = 0.676 * sqrt(2 / accel) seconds, the error-corrected first step
+    stepper.c0_q8 = (uint32_t)(0.676f * sqrtf(2.0f / accel) * 1e6f * 256.0f);
+    stepper.ramp_steps = (max_speed * max_speed) / (2 * accel);
+    if (stepper.ramp_steps == 0) stepper.ramp_steps = 1;
+    if (stepper.ramp_steps > steps / 2) stepper.ramp_steps = steps / 2; // Triangular profile
+    if (stepper.c0_q8 < stepper.cmin_q8) stepper.ramp_steps = 0;
+  } else {
+    stepper.ramp_steps = 0;
+  }
+
+  stepper.busy = true;
+  stepper.alarm = add_alarm_in_us(0, stepper_alarm, NULL, true);
+}
+
+bool stepper_busy(void) {
+  return stepper.busy;
+}
+
+// Aborts the current move immediately (no deceleration)
+void stepper_stop(void) {
+  if (stepper.alarm > 0) {
+    cancel_alarm(stepper.alarm);
+  }
+  stepper.alarm = 0;
+  stepper.busy = false;
+  stepper.step_high = false;
+  gpio_put(STEP_PIN, 0);
+}
+
+// Blocking rotation at a constant rate, kept for simple callers
+void stepper_rotate(bool direction, uint32_t duration_ms, uint32_t step_delay_ms) {
+  stepper_move(direction, duration_ms / step_delay_ms, 1000 / step_delay_ms, 0, NULL);
+  while (stepper_busy()) {
+    __wfe(); // Woken up by the step alarm
   }
 }
 
 // -------------------------------------------------------------------------------------------------- //
 // Buzzer
 
+/* Melodies are constant tables of notes whose PWM dividers are worked out at
+   compile time (BUZZER_NOTE), so starting a note costs two register writes.
+   A sequencer alarm steps through the table: each note re-arms the alarm
+   with a negative delay, i.e. relative to the previous deadline, so long
+   melodies do not drift, and the caller never waits. Starting a melody replaces the one playing. */
+typedef struct {
+  uint16_t div_q4;      // PWM clock divider in 8.4 fixed point, 0 for a rest
+  uint16_t duration_ms;
+} buzzer_note;
+
+typedef struct {
+  const buzzer_note *notes;
+  uint8_t count;
+  uint16_t level;       // Compare level out of BUZZER_WRAP (duty cycle)
+} buzzer_melody;
+
+#define BUZZER_WRAP 4095
+#define BUZZER_CLOCK_HZ 125000000ull
+// Smallest divider (rounded up to 1/16) that keeps the tone at or below freq
+#define BUZZER_DIV_Q4(freq) ((uint16_t)((BUZZER_CLOCK_HZ * 16 + (freq) * (BUZZER_WRAP + 1ull) - 1) / \
+                                        ((freq) * (BUZZER_WRAP + 1ull))))
+// Tones the 8.4 divider can reach: 1.0 at the top, 255 15/16 at the bottom
+#define BUZZER_MAX_HZ (BUZZER_CLOCK_HZ / (BUZZER_WRAP + 1))
+#define BUZZER_MIN_HZ 120
+#define BUZZER_NOTE(freq, ms) {BUZZER_DIV_Q4(freq), ms}
+#define BUZZER_REST(ms) {0, ms}
+#define BUZZER_MELODY(table, duty_pct) {table, sizeof(table) / sizeof(table[0]), BUZZER_WRAP * (duty_pct) / 100}
+
+static const buzzer_note error_notes[] = {
+  BUZZER_NOTE(3000, 200), BUZZER_REST(200), BUZZER_NOTE(3000, 200), BUZZER_REST(200),
+  BUZZER_NOTE(3000, 200), BUZZER_REST(200)
+};
+static const buzzer_note success_notes[] = {
+  BUZZER_NOTE(1000, 500), BUZZER_REST(100), BUZZER_NOTE(2000, 500)
+};
+static const buzzer_note coffee_ready_notes[] = {
+  BUZZER_NOTE(262, 200), BUZZER_REST(100), BUZZER_NOTE(294, 200), BUZZER_REST(100),
+  BUZZER_NOTE(330, 200), BUZZER_REST(100), BUZZER_NOTE(349, 200), BUZZER_REST(100),
+  BUZZER_NOTE(392, 400)
+};
+static const buzzer_note refill_notes[] = {
+  BUZZER_NOTE(400, 400), BUZZER_REST(300), BUZZER_NOTE(400, 400), BUZZER_REST(300),
+  BUZZER_NOTE(400, 400), BUZZER_REST(300), BUZZER_NOTE(400, 400), BUZZER_REST(300)
+};
+static const buzzer_note start_notes[] = {
+  BUZZER_NOTE(500, 600)
+};
+
+static const buzzer_melody error_melody = BUZZER_MELODY(error_notes, 50);
+static const buzzer_melody success_melody = BUZZER_MELODY(success_notes, 50);
+static const buzzer_melody coffee_ready_melody = BUZZER_MELODY(coffee_ready_notes, 50);
+static const buzzer_melody refill_melody = BUZZER_MELODY(refill_notes, 80);
+static const buzzer_melody start_melody = BUZZER_MELODY(start_notes, 80);
+
+static struct {
+  uint pin;
+  const buzzer_melody *melody;
+  uint8_t next;
+  alarm_id_t alarm;
+  volatile bool busy;
+} buzzer;
+
+// Level 0 is silent; the slice keeps running for the LED bar pin on its other channel
+static void buzzer_silence() {
+  pwm_set_gpio_level(buzzer.pin, 0);
+}
+
+static int64_t buzzer_alarm(alarm_id_t id, void *user_data) {
+  if (buzzer.next == buzzer.melody->count) {
+    buzzer_silence();
+    buzzer.busy = false;
+    buzzer.alarm = 0;
+    return 0;
+  }
+
+  const buzzer_note *note = &buzzer.melody->notes[buzzer.next++];
+  uint slice_num = pwm_gpio_to_slice_num(buzzer.pin);
+  if (note->div_q4 == 0) {
+    buzzer_silence();
+  } else {
+    pwm_set_clkdiv_int_frac(slice_num, note->div_q4 >> 4, note->div_q4 & 0xF);
+    pwm_set_chan_level(slice_num, pwm_gpio_to_channel(buzzer.pin), buzzer.melody->level);
+    pwm_set_enabled(slice_num, true);
+  }
+  return -(int64_t)note->duration_ms * 1000;
+}
+
+static void buzzer_play(uint pin, const buzzer_melody *melody) {
+  buzzer_stop();
+  buzzer.pin = pin;
+  buzzer.melody = melody;
+  buzzer.next = 0;
+  buzzer.busy = true;
+
+  gpio_set_function(pin, GPIO_FUNC_PWM);
+  pwm_set_wrap(pwm_gpio_to_slice_num(pin), BUZZER_WRAP);
+  buzzer.alarm = add_alarm_in_us(0, buzzer_alarm, NULL, true);
+}
+
+bool buzzer_busy(void) {
+  return buzzer.busy;
+}
+
+void buzzer_stop(void) {
+  if (buzzer.alarm > 0) {
+    cancel_alarm(buzzer.alarm);
+  }
+  buzzer.alarm = 0;
+  if (buzzer.busy) buzzer_silence();
+  buzzer.busy = false;
+}
+
+// Runtime frequency, for ad-hoc tones: the divider is computed here rather than from a table
+// and freq is clamped to what the divider can produce
 void setup_pwm(uint pin, uint freq, float duty_cycle) {
+  if (freq < BUZZER_MIN_HZ) freq = BUZZER_MIN_HZ;
+  if (freq > BUZZER_MAX_HZ) freq = BUZZER_MAX_HZ;
   gpio_set_function(pin, GPIO_FUNC_PWM);
   uint slice_num = pwm_gpio_to_slice_num(pin);
   uint channel = pwm_gpio_to_channel(pin);
 
-  uint32_t clock = 125000000;
-  uint32_t divider16 = clock / freq / 4096 + (clock % (freq * 4096) != 0);
-  pwm_set_clkdiv(slice_num, divider16 / 16.0f);
-  pwm_set_wrap(slice_num, 4095);
-  pwm_set_chan_level(slice_num, channel, (uint32_t)(4095 * duty_cycle));
+  uint16_t div_q4 = BUZZER_DIV_Q4(freq);
+  pwm_set_clkdiv_int_frac(slice_num, div_q4 >> 4, div_q4 & 0xF);
+  pwm_set_wrap(slice_num, BUZZER_WRAP);
+  pwm_set_chan_level(slice_num, channel, (uint32_t)(BUZZER_WRAP * duty_cycle));
   pwm_set_enabled(slice_num, true);
 }
 
+// Like buzzer_silence: the slice stays enabled for the LED bar pin on its other channel
 void stop_pwm(uint pin) {
-  uint slice_num = pwm_gpio_to_slice_num(pin);
-  uint channel = pwm_gpio_to_channel(pin);
-  pwm_set_chan_level(slice_num, channel, 0);
-  pwm_set_enabled(slice_num, false);
+  pwm_set_gpio_level(pin, 0);
 }
 
+// Blocking, kept for simple callers
 void play_tone(uint pin, uint freq, uint duration_ms, float duty_cycle) {
   setup_pwm(pin, freq, duty_cycle);
   sleep_ms(duration_ms);
   stop_pwm(pin);
 }
 
+// The melodies below start in the background and return at once
 void play_error_tone(uint pin) {
-  for (int i = 0; i < 3; i++) {
-    play_tone(pin, 3000, 200, 0.5);
-    sleep_ms(200);
-  }
-}
-
-void play_beep_pattern(uint pin, uint freq, uint duration_ms, uint pause_ms, int repetitions, float duty_cycle) {
-  for (int i = 0; i < repetitions; i++) {
-    play_tone(pin, freq, duration_ms, duty_cycle);
-    sleep_ms(pause_ms);
-  }
+  buzzer_play(pin, &error_melody);
 }
 
 void play_success_tone(uint pin) {
-  play_tone(pin, 1000, 500, 0.5);
-  sleep_ms(100);
-  play_tone(pin, 2000, 500, 0.5);
+  buzzer_play(pin, &success_melody);
 }
 
 void play_coffee_ready(uint pin) {
-  play_tone(pin, 262, 200, 0.5);
-  sleep_ms(100);
-  play_tone(pin, 294, 200, 0.5);
-  sleep_ms(100);
-  play_tone(pin, 330, 200, 0.5);
-  sleep_ms(100);
-  play_tone(pin, 349, 200, 0.5);
-  sleep_ms(100);
-  play_tone(pin, 392, 400, 0.5);
+  buzzer_play(pin, &coffee_ready_melody);
+}
+
+void play_refill_alert(uint pin) {
+  buzzer_play(pin, &refill_melody);
+}
+
+void play_start_tone(uint pin) {
+  buzzer_play(pin, &start_melody);
 }
\ No newline at end of file
@@ -11,30 +11,59 @@
 // Functions for LEDs and LED bar control
 void init_leds();
 void init_led_bar();
-void blink_led_bar(int times, int interval_ms); // Blinks the LED bar a specified number of times
-void update_led_bar(int pressure);              // Updates the LED bar based on coffee strength
+// LED bar effects run from a timer and return immediately; a new one replaces the running one
+void blink_led_bar(int times, int interval_ms); // Blinks the LED bar a specified number of times, ending dark
+void update_led_bar(int pressure);              // Fills the LED bar to the coffee strength, then breathes
+bool led_bar_busy(void);                        // True while an effect is running
+void led_bar_stop(void);                        // Ends the effect, leaving its LEDs steadily on
 
 // Functions for servomotor control
+#define SERVO_BEAN_GATE 1   // Servo 1
+#define SERVO_COFFEE_GATE 2 // Servo 2
+
+// One point of a servo path: eases to angle over move_ms, then stays there for hold_ms
+typedef struct {
+  uint8_t angle;
+  uint16_t move_ms;
+  uint16_t hold_ms;
+} servo_waypoint;
+
+typedef void (*servo_done_callback)(uint servo); // Called from interrupt context when a path ends
+
 void servo_init(void);        // Initializes PWM for servomotors
 void servo1_move(uint angle); // Moves servo 1 to the specified angle (0 to 180 degrees)
 void servo2_move(uint angle); // Moves servo 2 to the specified angle (0 to 180 degrees)
-void servo1_motion(void);     // Simulates the movement cycle to release coffee beans
-void servo2_motion(void);     // Simulates the movement cycle to release ground coffee
+void servo_play(uint servo, const servo_waypoint *path, uint count, servo_done_callback on_done);
+// Starts a path from the current position and returns immediately; several servos can move at once
+bool servo_busy(uint servo);  // True while a path is playing
+void servo_stop(uint servo);  // Holds the servo where it is
+void servo1_motion(void);     // Simulates the movement cycle to release coffee beans (blocking)
+void servo2_motion(void);     // Simulates the movement cycle to release ground coffee (blocking)
 
 // Functions for stepper motor control
+typedef void (*stepper_done_callback)(void); // Called from interrupt context when a move ends
+
 void stepper_init(void); // Initializes stepper motor pins
+void stepper_move(bool direction, uint32_t steps, uint32_t max_speed, uint32_t accel, stepper_done_callback on_done);
+// Starts a move of a number of steps with trapezoidal acceleration (steps/s, steps/s^2); returns immediately
+bool stepper_busy(void); // True while a move is in progress
+void stepper_stop(void); // Aborts the current move
 void stepper_rotate(bool direction, uint32_t duration_ms, uint32_t step_delay_ms); 
-// Rotates the motor continuously for a specified time (in ms) in the given direction
+// Rotates the motor continuously for a specified time (in ms) in the given direction (blocking)
 
 // Functions for buzzer control
 void setup_pwm(uint pin, uint freq, float duty_cycle); // Sets up PWM for the specified pin with frequency and duty cycle
-void stop_pwm(uint pin);                               // Stops PWM on the specified pin
+void stop_pwm(uint pin);                               // Silences the specified pin; its slice keeps running
 void play_tone(uint pin, uint freq, uint duration_ms, float duty_cycle); 
-// Plays a tone on the specified pin for a given duration in milliseconds
-void play_beep_pattern(uint pin, uint freq, uint duration_ms, uint pause_ms, int repetitions, float duty_cycle); 
-// Plays a beep pattern with frequency, duration, pause, and repetitions
+// Plays a tone on the specified pin for a given duration in milliseconds (blocking)
+
+// Melodies play in the background from a timer alarm; a new one replaces the one playing
 void play_error_tone(uint pin);       // Plays an error tone
 void play_success_tone(uint pin);     // Plays a success tone (ascending frequencies)
 void play_coffee_ready(uint pin);     // Plays a sound to indicate that the coffee is ready
+void play_refill_alert(uint pin);     // Four low beeps: the machine needs refilling
+void play_start_tone(uint pin);       // Plays the tone at the start of preparation
+bool buzzer_busy(void);               // True while a melody is playing
+void buzzer_stop(void);               // Cuts the current melody short
 
 #endif // ACTUATORS_H
\ No newline at end of file
@@ -0,0 +1,66 @@
+// event_loop.c
+// Tickless main loop support
+
+#include "event_loop.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+static volatile uint32_t pending = EVENT_NONE;
+static absolute_time_t deadlines[EVENT_TIMER_COUNT];
+static uint32_t armed = EVENT_NONE;
+
+static int event_index(uint32_t event) {
+  int i = 0;
+  while (i < EVENT_TIMER_COUNT && (event >> i) != 1u) i++;
+  return i;
+}
+
+void event_post(uint32_t events) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  pending |= events;
+  restore_interrupts(irq_state);
+  __sev(); // Wakes the core if it is sitting in WFE
+}
+
+void event_schedule(uint32_t event, absolute_time_t at) {
+  int i = event_index(event);
+  if (i >= EVENT_TIMER_COUNT) return;
+  deadlines[i] = at;
+  armed |= event;
+}
+
+void event_cancel(uint32_t event) {
+  armed &= ~event;
+}
+
+// Moves expired deadlines into the pending set and returns the earliest one still armed
+static absolute_time_t collect_expired() {
+  absolute_time_t now = get_absolute_time();
+  absolute_time_t earliest = at_the_end_of_time;
+  for (int i = 0; i < EVENT_TIMER_COUNT; i++) {
+    uint32_t event = 1u << i;
+    if (!(armed & event)) continue;
+    if (absolute_time_diff_us(now, deadlines[i]) <= 0) {
+      armed &= ~event;
+      event_post(event);
+    } else if (absolute_time_diff_us(deadlines[i], earliest) > 0) {
+      earliest = deadlines[i];
+    }
+  }
+  return earliest;
+}
+
+uint32_t event_wait() {
+  while (true) {
+    absolute_time_t earliest = collect_expired();
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t events = pending;
+    pending = EVENT_NONE;
+    restore_interrupts(irq_state);
+    if (events != EVENT_NONE) return events;
+
+    // Sleeps until an interrupt posts an event or the next deadline passes
+    best_effort_wfe_or_timeout(earliest);
+  }
+}
@@ -0,0 +1,32 @@
+// event_loop.h
+// Tickless main loop support: wake sources posted from interrupts or armed as
+// deadlines, and a wait that sleeps the core (WFE) until one of them fires.
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/time.h"
+
+// Wake sources (bit flags)
+typedef enum {
+  EVENT_NONE           = 0,
+  EVENT_INPUT          = 1u << 0, // IR key decoded
+  EVENT_STATE_CHANGE   = 1u << 1, // The state machine moved to another state
+  EVENT_CLOCK_MINUTE   = 1u << 2, // The RTC crossed a minute boundary
+  EVENT_SENSOR_REFRESH = 1u << 3, // Time to refresh the ambient reading
+  EVENT_ACTUATOR_STEP  = 1u << 4, // An actuator sequence has work due
+  EVENT_SCHEDULE       = 1u << 5, // A scheduled brew is due
+  EVENT_IDLE_TIMEOUT   = 1u << 6, // Nobody touched the initial screen for a while (power.h)
+  EVENT_SCREEN_TIMEOUT = 1u << 7, // A menu message or input timeout ran out
+} Event;
+
+#define EVENT_TIMER_COUNT 8 // One deadline slot per event bit
+
+void event_post(uint32_t events);                      // Marks events pending; safe from interrupts
+void event_schedule(uint32_t event, absolute_time_t at); // Arms (or moves) the deadline of a timed event
+void event_cancel(uint32_t event);                     // Disarms a timed event
+uint32_t event_wait();                                 // Sleeps until something is pending, then returns and clears it
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,213 @@
+// flash_kv.c
+
+#include "flash_kv.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include <string.h>
+
+#define KV_OFFSET         (PICO_FLASH_SIZE_BYTES - FLASH_KV_SECTORS * FLASH_SECTOR_SIZE)
+#define KV_MAGIC          0x31564B46u // "FKV1"
+#define KV_HEADER_BYTES   10
+#define KV_RECORD_BYTES(len) (2 + (len) + 2)
+#define KV_FREE           0xFF        // Key byte of erased space
+#define KV_LOCKOUT_MS     100         // Wait for core 1 to park before giving up on a write
+// Largest write: a header plus one record per key, spanning at most one extra page
+#define KV_BUFFER_PAGES   ((KV_HEADER_BYTES + FLASH_KV_KEYS * KV_RECORD_BYTES(FLASH_KV_VALUE_MAX)) / FLASH_PAGE_SIZE + 2)
+
+typedef struct {
+  uint8_t len;
+  bool present;
+  bool dirty; // Changed since it was last written
+  uint8_t value[FLASH_KV_VALUE_MAX];
+} kv_entry;
+
+static kv_entry entries[FLASH_KV_KEYS];
+static int active = -1;          // Sector holding the newest generation, -1 before the first write
+static uint32_t write_offset;    // Free space in the active sector starts here
+static flash_kv_stats stats;
+static uint8_t buffer[KV_BUFFER_PAGES * FLASH_PAGE_SIZE];
+
+static const uint8_t *sector_data(int sector) {
+  return (const uint8_t *)(XIP_BASE + KV_OFFSET + sector * FLASH_SECTOR_SIZE);
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++ << 8);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static uint32_t get_le(const uint8_t *p, int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+  return value;
+}
+
+static void put_le(uint8_t *p, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+// ---------------------------------- Flash Access ---------------------------------- //
+typedef struct {
+  uint32_t offset;
+  const uint8_t *data;
+  size_t len;
+  bool erase; // The sector at offset first
+} flash_op;
+
+static void flash_op_run(void *param) {
+  const flash_op *op = param;
+  if (op->erase) flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+  if (op->len) flash_range_program(op->offset, op->data, op->len);
+}
+
+static bool flash_run(uint32_t offset, const uint8_t *data, size_t len, bool erase) {
+  flash_op op = {offset, data, len, erase};
+  return flash_safe_execute(flash_op_run, &op, KV_LOCKOUT_MS) == PICO_OK;
+}
+
+// Programs bytes at an offset inside a sector; the rest of their pages stays as it is
+// (programming 0xFF leaves NOR flash untouched)
+static bool program_bytes(int sector, uint32_t offset, const uint8_t *data, size_t len) {
+  uint32_t first = offset & ~(FLASH_PAGE_SIZE - 1);
+  uint32_t end = (offset + len + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+  memset(buffer, 0xFF, end - first);
+  memcpy(buffer + (offset - first), data, len);
+  return flash_run(KV_OFFSET + sector * FLASH_SECTOR_SIZE + first, buffer, end - first, false);
+}
+
+// ---------------------------------- Records ---------------------------------- //
+// Writes a record into out; returns its size
+static size_t encode(uint8_t key, const kv_entry *e, uint8_t *out) {
+  out[0] = key;
+  out[1] = e->len;
+  memcpy(out + 2, e->value, e->len);
+  put_le(out + 2 + e->len, crc16(0xFFFF, out, 2 + e->len), 2);
+  return KV_RECORD_BYTES(e->len);
+}
+
+static bool header_valid(const uint8_t *h, uint32_t *generation) {
+  if (get_le(h, 4) != KV_MAGIC || get_le(h + 8, 2) != crc16(0xFFFF, h, 8)) return false;
+  *generation = get_le(h + 4, 4);
+  return true;
+}
+
+// One pass over the active sector; stops at free space or at the first damaged record
+static void scan(int sector) {
+  const uint8_t *data = sector_data(sector);
+  uint32_t offset = KV_HEADER_BYTES;
+  while (offset + KV_RECORD_BYTES(0) <= FLASH_SECTOR_SIZE && data[offset] != KV_FREE) {
+    uint8_t key = data[offset];
+    uint8_t len = data[offset + 1];
+    if (key >= FLASH_KV_KEYS || len > FLASH_KV_VALUE_MAX || offset + KV_RECORD_BYTES(len) > FLASH_SECTOR_SIZE ||
+        get_le(data + offset + 2 + len, 2) != crc16(0xFFFF, data + offset, 2 + len)) {
+      stats.torn = true;
+      offset = FLASH_SECTOR_SIZE; // Nothing more is appended here
+      break;
+    }
+    entries[key].present = true;
+    entries[key].len = len;
+    memcpy(entries[key].value, data + offset + 2, len);
+    offset += KV_RECORD_BYTES(len);
+  }
+  write_offset = offset;
+  stats.boot_scan_bytes = offset < FLASH_SECTOR_SIZE ? offset + 1 : FLASH_SECTOR_SIZE;
+}
+
+// ---------------------------------- Compaction ---------------------------------- //
+/* The live values go to the next sector in turn: erase, records, then the header
+   last, so a reset half way leaves a sector without a header and the old one active. */
+static bool compact() {
+  int next = (active + 1) % FLASH_KV_SECTORS;
+  uint32_t generation = active < 0 ? 1 : stats.generation + 1;
+
+  uint8_t records[FLASH_KV_KEYS * KV_RECORD_BYTES(FLASH_KV_VALUE_MAX)];
+  size_t len = 0;
+  for (int key = 0; key < FLASH_KV_KEYS; key++) {
+    if (entries[key].present) len += encode(key, &entries[key], records + len);
+  }
+
+  if (!flash_run(KV_OFFSET + next * FLASH_SECTOR_SIZE, NULL, 0, true)) return false;
+  if (len > 0 && !program_bytes(next, KV_HEADER_BYTES, records, len)) return false;
+
+  uint8_t header[KV_HEADER_BYTES];
+  put_le(header, KV_MAGIC, 4);
+  put_le(header + 4, generation, 4);
+  put_le(header + 8, crc16(0xFFFF, header, 8), 2);
+  if (!program_bytes(next, 0, header, sizeof(header))) return false;
+
+  active = next;
+  write_offset = KV_HEADER_BYTES + len;
+  stats.generation = generation;
+  stats.compactions++;
+  stats.torn = false;
+  for (int key = 0; key < FLASH_KV_KEYS; key++) entries[key].dirty = false;
+  return true;
+}
+
+// ---------------------------------- Public API ---------------------------------- //
+void flash_kv_init() {
+  memset(entries, 0, sizeof(entries));
+  memset(&stats, 0, sizeof(stats));
+  active = -1;
+  for (int sector = 0; sector < FLASH_KV_SECTORS; sector++) {
+    uint32_t generation;
+    if (!header_valid(sector_data(sector), &generation)) continue;
+    if (active < 0 || (int32_t)(generation - stats.generation) > 0) { // Survives the counter wrapping
+      active = sector;
+      stats.generation = generation;
+    }
+  }
+  if (active >= 0) scan(active);
+}
+
+int flash_kv_get(uint8_t key, void *value, uint8_t size) {
+  if (key >= FLASH_KV_KEYS || !entries[key].present) return -1;
+  memcpy(value, entries[key].value, entries[key].len < size ? entries[key].len : size);
+  return entries[key].len;
+}
+
+bool flash_kv_put(uint8_t key, const void *value, uint8_t len) {
+  if (key >= FLASH_KV_KEYS || len > FLASH_KV_VALUE_MAX) return false;
+  kv_entry *e = &entries[key];
+  if (e->present && e->len == len && memcmp(e->value, value, len) == 0) return true;
+  memcpy(e->value, value, len);
+  e->len = len;
+  e->present = true;
+  e->dirty = true;
+  return true;
+}
+
+bool flash_kv_sync() {
+  uint8_t records[FLASH_KV_KEYS * KV_RECORD_BYTES(FLASH_KV_VALUE_MAX)];
+  size_t len = 0;
+  for (int key = 0; key < FLASH_KV_KEYS; key++) {
+    if (entries[key].dirty) len += encode(key, &entries[key], records + len);
+  }
+  if (len == 0) return true;
+  if (active < 0 || write_offset + len > FLASH_SECTOR_SIZE) return compact();
+
+  if (!program_bytes(active, write_offset, records, len)) return false;
+  write_offset += len;
+  for (int key = 0; key < FLASH_KV_KEYS; key++) {
+    if (entries[key].dirty) stats.appends++;
+    entries[key].dirty = false;
+  }
+  return true;
+}
+
+bool flash_kv_compact_if_low() {
+  if (active < 0 || FLASH_SECTOR_SIZE - write_offset >= FLASH_KV_LOW_BYTES) return true;
+  return compact();
+}
+
+flash_kv_stats flash_kv_get_stats() {
+  flash_kv_stats s = stats;
+  s.used_bytes = active < 0 ? 0 : write_offset;
+  return s;
+}
@@ -0,0 +1,44 @@
+// flash_kv.h
+
+// Log-structured key/value store in the last FLASH_KV_SECTORS sectors of flash:
+// - flash_kv_put() only updates a RAM copy; flash_kv_sync() appends one compact record per
+//   changed key to the active sector, all in one page program
+// - When the active sector is full, the live values are compacted into the next sector, which
+//   takes over with a higher generation; the sectors are used in turn to spread the erases
+// - flash_kv_init() reads the sector headers and scans the newest sector once, so boot reads at
+//   most one sector of records; the last good record of each key wins, a torn one ends the scan
+// - Erasing and programming stop XIP: both run through flash_safe_execute() (core 1 locked out,
+//   interrupts off), so callers sync from the main loop and never during a brew
+//
+// Sector: header {"FKV1", generation (u32), CRC-16 of both (u16)}, then records up to the first 0xFF key
+// Record: key (u8), length (u8), value, CRC-16/CCITT of key + length + value (u16); little-endian
+// The program image must leave the last FLASH_KV_SECTORS sectors free.
+
+#ifndef FLASH_KV_H
+#define FLASH_KV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FLASH_KV_SECTORS   4  // Rotation depth: each sector is erased once per this many compactions
+#define FLASH_KV_KEYS      8  // Keys 0 .. FLASH_KV_KEYS - 1
+#define FLASH_KV_VALUE_MAX 48 // Bytes per value
+#define FLASH_KV_LOW_BYTES 512 // flash_kv_compact_if_low() compacts below this much free space
+
+typedef struct {
+  uint32_t generation;   // Of the active sector
+  uint16_t used_bytes;   // Header and records in the active sector
+  uint16_t boot_scan_bytes; // Read by flash_kv_init()
+  uint32_t appends;      // Records appended since boot
+  uint32_t compactions;  // Sector erases since boot
+  bool torn;             // The scan stopped at a damaged record; the next sync compacts
+} flash_kv_stats;
+
+void flash_kv_init();                                          // Restores the RAM copy from flash
+int flash_kv_get(uint8_t key, void *value, uint8_t size);      // Stored length (value copied up to size), -1 if none
+bool flash_kv_put(uint8_t key, const void *value, uint8_t len); // RAM only; an unchanged value is not rewritten
+bool flash_kv_sync();                                          // Writes the changed keys; may erase one sector
+bool flash_kv_compact_if_low();                                // Compacts ahead of need, e.g. when the machine idles
+flash_kv_stats flash_kv_get_stats();
+
+#endif // FLASH_KV_H
@@ -0,0 +1,129 @@
+// i2c_bus.c
+// Shared I2C bus manager for the LCD display and the RTC
+
+#include "i2c_bus.h"
+#include "profile.h"
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+#include <string.h>
+
+// Shared pins for the LCD and RTC
+#define I2C_PORT i2c0
+#define SDA_PIN 4
+#define SCL_PIN 5
+
+// Fastest clock each part is rated for. Both the PCF8574 and the DS1307 are
+// standard-mode (100 kHz) devices; raise these when fitting fast-mode parts
+// (e.g. a PCF8574 clone rated for 400 kHz or a DS3231).
+#ifndef LCD_I2C_MAX_HZ
+#define LCD_I2C_MAX_HZ (100 * 1000)
+#endif
+#ifndef RTC_I2C_MAX_HZ
+#define RTC_I2C_MAX_HZ (100 * 1000)
+#endif
+
+typedef struct {
+  uint8_t address;
+  uint32_t max_hz;
+} i2c_device_info;
+
+static const i2c_device_info devices[I2C_DEVICE_COUNT] = {
+  [I2C_DEVICE_LCD] = {0x27, LCD_I2C_MAX_HZ}, // LCD_ADDR
+  [I2C_DEVICE_RTC] = {0x68, RTC_I2C_MAX_HZ}, // DS1307 fixed address
+};
+
+static i2c_bus_stats stats[I2C_DEVICE_COUNT];
+static bool initialized = false;
+static uint32_t baudrate = 0;
+static uint32_t target_hz = 0; // Requested clock; baudrate is what the divider achieved
+auto_init_mutex(bus_mutex);
+
+void i2c_bus_init() {
+  if (initialized) return;
+
+  // The bus can only go as fast as its slowest device
+  uint32_t hz = I2C_BUS_MAX_HZ;
+  for (int i = 0; i < I2C_DEVICE_COUNT; i++) {
+    if (devices[i].max_hz < hz) hz = devices[i].max_hz;
+  }
+  target_hz = hz;
+  baudrate = i2c_init(I2C_PORT, hz);
+
+  // Defines SDA and SCL pins
+  gpio_set_function(SDA_PIN, GPIO_FUNC_I2C);
+  gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
+  // Enables pull-up resistors for stable communication
+  gpio_pull_up(SDA_PIN);
+  gpio_pull_up(SCL_PIN);
+
+  initialized = true;
+}
+
+uint32_t i2c_bus_get_baudrate() {
+  return baudrate;
+}
+
+// The divider is derived from clk_peri, so it is wrong once the system clocks move
+void i2c_bus_clock_changed() {
+  if (!initialized) return;
+  mutex_enter_blocking(&bus_mutex);
+  baudrate = i2c_set_baudrate(I2C_PORT, target_hz);
+  mutex_exit(&bus_mutex);
+}
+
+// Updates the counters of one transaction (called with the bus locked)
+static void account(I2cDevice device, int ret, size_t len) {
+  stats[device].transactions++;
+  profile_count(PROFILE_COUNT_I2C_TRANSACTIONS, 1);
+  if (ret < 0) {
+    stats[device].errors++;
+    profile_count(PROFILE_COUNT_I2C_ERRORS, 1);
+  } else {
+    stats[device].bytes += len + 1;
+    profile_count(PROFILE_COUNT_I2C_BYTES, len + 1);
+  }
+}
+
+int i2c_bus_write(I2cDevice device, const uint8_t *src, size_t len) {
+  mutex_enter_blocking(&bus_mutex);
+  int ret = i2c_write_blocking(I2C_PORT, devices[device].address, src, len, false);
+  account(device, ret, len);
+  mutex_exit(&bus_mutex);
+  return ret;
+}
+
+int i2c_bus_read(I2cDevice device, uint8_t *dst, size_t len) {
+  mutex_enter_blocking(&bus_mutex);
+  int ret = i2c_read_blocking(I2C_PORT, devices[device].address, dst, len, false);
+  account(device, ret, len);
+  mutex_exit(&bus_mutex);
+  return ret;
+}
+
+// Both halves run under one lock so no other device can take the bus between them
+int i2c_bus_read_register(I2cDevice device, uint8_t reg, uint8_t *dst, size_t len) {
+  mutex_enter_blocking(&bus_mutex);
+  int ret = i2c_write_blocking(I2C_PORT, devices[device].address, &reg, 1, true);
+  account(device, ret, 1);
+  if (ret >= 0) {
+    ret = i2c_read_blocking(I2C_PORT, devices[device].address, dst, len, false);
+    account(device, ret, len);
+  }
+  mutex_exit(&bus_mutex);
+  return ret;
+}
+
+i2c_bus_stats i2c_bus_get_stats(I2cDevice device) {
+  mutex_enter_blocking(&bus_mutex);
+  i2c_bus_stats s = stats[device];
+  mutex_exit(&bus_mutex);
+  return s;
+}
+
+void i2c_bus_reset_stats() {
+  mutex_enter_blocking(&bus_mutex);
+  memset(stats, 0, sizeof(stats));
+  mutex_exit(&bus_mutex);
+}
@@ -0,0 +1,41 @@
+// i2c_bus.h
+// Shared I2C bus manager for the LCD display and the RTC.
+// Owns i2c0: configures the pins once, picks the fastest clock every attached
+// device supports, serializes transactions and keeps per-device statistics.
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Highest clock the bus may run at (I2C fast mode)
+#ifndef I2C_BUS_MAX_HZ
+#define I2C_BUS_MAX_HZ (400 * 1000)
+#endif
+
+// Devices on the shared bus
+typedef enum {
+  I2C_DEVICE_LCD,  // PCF8574 expander driving the 20x4 LCD
+  I2C_DEVICE_RTC,  // DS1307 real-time clock
+  I2C_DEVICE_COUNT
+} I2cDevice;
+
+// Traffic counters for one device
+typedef struct {
+  uint32_t transactions; // START..STOP sequences addressed to the device
+  uint32_t bytes;        // Bytes on the bus, address byte included
+  uint32_t errors;       // Transactions the device did not acknowledge
+} i2c_bus_stats;
+
+void i2c_bus_init();                    // Configures i2c0 and its pins (only the first call does anything)
+uint32_t i2c_bus_get_baudrate();        // Clock the bus is running at, in Hz
+void i2c_bus_clock_changed();           // Recomputes the divider after clk_peri changed (sleep and wake)
+int i2c_bus_write(I2cDevice device, const uint8_t *src, size_t len);
+int i2c_bus_read(I2cDevice device, uint8_t *dst, size_t len);
+int i2c_bus_read_register(I2cDevice device, uint8_t reg, uint8_t *dst, size_t len); // Register pointer write + repeated-start read
+i2c_bus_stats i2c_bus_get_stats(I2cDevice device);
+void i2c_bus_reset_stats();
+
+#endif // I2C_BUS_H
@@ -5,8 +5,14 @@
 #include "sensors.h"
 #include "actuators.h"
 #include "lcd_i2c.h"
+#include "lcd_format.h"
+#include "display_task.h"
 #include "user_interface.h"
 #include "state.h"
+#include "event_loop.h"
+#include "time_service.h"
+#include "profile.h"
+#include "flash_kv.h"
 #include <stdio.h>
 #include "pico/stdlib.h"
 
@@ -14,9 +20,13 @@
 #define BUZZER_PIN 14  // Buzzer for sound notifications
 #define BLUE_LED 13    // Blue LED: indicates that the coffee preparation process is active
 
-extern float water_ml;
-extern float coffee_beans_g;
-extern bool play_pressed;
+// Grinder: 1000 steps at 200 steps/s (same travel as 5 s at 5 ms per step), short ramps
+#define GRIND_STEPS 1000
+#define GRIND_SPEED 200  // steps/s
+#define GRIND_ACCEL 800  // steps/s^2
+
+extern int water_ml;
+extern int coffee_beans_g;
 extern State current_state;
 
 void setup_machine() {
@@ -24,9 +34,13 @@ void setup_machine() {
   init_leds();
   init_led_bar();
   init_i2c_lcd();
+  display_task_start(); // Core 1 owns the LCD from here on
+  time_service_init();
+  flash_kv_init();
+  restore_machine_state(); // Levels and pending brews from before the power cycle
   servo_init();
   stepper_init();
-  gpio_init(DHT_PIN);
+  dht_start_sampling(DHT_PIN);
   init_adc();
   play_success_tone(BUZZER_PIN);
 
@@ -40,27 +54,6 @@ void setup_machine() {
   printf(">> The initial screen updates the values as they change.\n");
 }
 
-// Simulates water heating to the desired temperature
-void simulate_water_heating(float desired_temp) {
-  float current_temp = 25.0;
-  lcd_clear();
-  lcd_set_cursor(1, 2);
-  lcd_print("HEATING WATER...");
-
-  while (current_temp <= desired_temp) {
-    char buffer[16];
-    snprintf(buffer, sizeof(buffer), "TEMP: %.1f C", current_temp);
-    lcd_set_cursor(2, 4);
-    lcd_print(buffer);
-    current_temp += 2.5;
-    sleep_ms(400);
-  }
-
-  lcd_clear();
-  type_effect("   WATER READY!", 1, 50);
-  sleep_ms(500);
-}
-
 // Determines coffee strength based on pressure
 const char* determine_coffee_strength(int pressure) {
   if (pressure <= 33) return "MILD";
@@ -69,95 +62,362 @@ const char* determine_coffee_strength(int pressure) {
 }
 
 // Determines coffee temperature level
-const char* determine_temperature_level(float temperature) {
-  if (temperature < 90) return "WARM";
-  else if (temperature < 94) return "HOT";
+const char* determine_temperature_level(int16_t temp_x10) {
+  if (temp_x10 < 900) return "WARM";
+  else if (temp_x10 < 940) return "HOT";
   else return "HOT++";
 }
 
-// Main function to simulate coffee preparation
-// 1. Verifies resources
-// 2. Lights up the LED bar based on coffee strength
-// 3. Simulates water heating to the desired temperature
-// 4. Moves servos and the stepper motor
-// 5. Finalizes the process and updates resources
-void prepare_coffee(int cups) {
-  int pressure = read_intensity();                   // Coffee strength (extraction pressure)
-  float desired_temp = read_desired_temperature();   // Desired beverage temperature
-  int water_per_cup = read_water_quantity();         // Water amount per cup
-  const char* strength = determine_coffee_strength(pressure);
-  const char* temp_level = determine_temperature_level(desired_temp);
+// -------------------------------------------------------------------------------------------------- //
+// Brew Pipeline
+/* Coffee preparation is a set of stages driven by the main loop. Each stage has a
+   start/poll/complete contract: start() runs once when all the stages listed in
+   `after` have completed, poll() is called on every wake-up until it returns true,
+   and complete() runs once afterwards. Stages never sleep; they ask for the next
+   wake-up with brew_wake_at(), so heating, bean release and grinding overlap.
+
+   RESOURCES -> START -> HEATING -------------------> EXTRACTION -> RELEASE -> FINISH
+                      -> BEANS -> GRINDING ---------/                                   */
+
+typedef enum {
+  BREW_STAGE_RESOURCES,  // Checks water and beans, waits for a refill if needed
+  BREW_STAGE_START,      // Start tone and progress bar
+  BREW_STAGE_HEATING,    // Heats the water to the desired temperature
+  BREW_STAGE_BEANS,      // Servo 1 releases the coffee beans
+  BREW_STAGE_GRINDING,   // Stepper motor grinds the beans
+  BREW_STAGE_EXTRACTION, // Extraction time, depends on the intensity
+  BREW_STAGE_RELEASE,    // Servo 2 releases the ground coffee
+  BREW_STAGE_FINISH,     // Ready message and tune, then back to the initial screen
+  BREW_STAGE_COUNT
+} BrewStageId;
+
+#define STAGE(id) (1u << (id))
+#define ALL_STAGES (STAGE(BREW_STAGE_COUNT) - 1)
+
+typedef struct {
+  void (*start)(void);
+  bool (*poll)(void);    // Returns true once the stage has finished
+  void (*complete)(void);
+  uint32_t after;        // Stages that must complete before this one starts
+} BrewStage;
+
+// Gate paths played by the servo engine. A stage ends once its gate is fully open;
+// the gate then closes in the background while the next stages run.
+static const servo_waypoint gate_home[] = {{0, 300, 0}};
+static const servo_waypoint gate_open[] = {{90, 300, 400}, {180, 300, 400}};
+static const servo_waypoint gate_close[] = {{0, 500, 0}};
+static const servo_waypoint gate_ajar[] = {{45, 300, 0}};
+
+#define PATH_LENGTH(path) (sizeof(path) / sizeof(path[0]))
+
+static struct {
+  int cups;
+  int pressure;              // Coffee strength (extraction pressure)
+  int16_t desired_temp_x10;  // Desired beverage temperature (0.1 °C)
+  int water_per_cup;         // Water amount per cup
+  const char *strength;
+  const char *temp_level;
+  bool needs_refill;
+  bool refill_confirmed;     // PLAY pressed while the refill alert is shown
+  absolute_time_t refill_due;
+
+  uint32_t started;          // Stages whose start() has run
+  uint32_t completed;        // Stages whose complete() has run
+  uint32_t brew_start_us;    // For the profile spans
+  uint32_t stage_start_us[BREW_STAGE_COUNT];
+  absolute_time_t wake_at;   // Earliest deadline requested during this poll
+
+  absolute_time_t start_due;
+  int progress;
+  absolute_time_t heating_due;
+  int16_t current_temp_x10;  // 0.1 °C
+  absolute_time_t extraction_due;
+  absolute_time_t finish_due;
+} brew;
+
+static void brew_wake_at(absolute_time_t t) {
+  if (absolute_time_diff_us(t, brew.wake_at) > 0) brew.wake_at = t;
+}
 
-  check_simulated_resources(cups, water_per_cup); // Verifies resources using a simulated routine
+// Returns true when the deadline has passed, otherwise asks to be woken up for it
+static bool brew_deadline_reached(absolute_time_t due) {
+  if (time_reached(due)) return true;
+  brew_wake_at(due);
+  return false;
+}
+
+// Runs from the servo frame alarm: wakes the main loop when a gate path ends
+static void gate_done(uint servo) {
+  event_post(EVENT_ACTUATOR_STEP);
+}
+
+// Status rows shared by the overlapping stages
+static void show_mechanics(const char *status) {
+  lcd_set_cursor(3, 0);
+  lcd_print(status);
+}
 
+// ---- RESOURCES ---- //
+static void resources_start() {
+  brew.needs_refill = check_simulated_resources(brew.cups, brew.water_per_cup);
+  brew.refill_confirmed = false;
+  brew.refill_due = nil_time;
+}
+
+static bool resources_poll() {
+  if (!brew.needs_refill) return true;
+  if (is_nil_time(brew.refill_due)) {
+    if (!brew.refill_confirmed) return false; // Woken up by the PLAY key
+    refill_simulated_resources();
+    brew.refill_due = make_timeout_time_ms(2000); // Keeps "READY AGAIN!" on screen
+  }
+  return brew_deadline_reached(brew.refill_due);
+}
+
+// ---- START ---- //
+static void start_start() {
   gpio_put(BLUE_LED, 1); // Turn on the blue LED to indicate preparation
-  play_tone(BUZZER_PIN, 500, 600, 0.8);  // Sound at the start of preparation
-  sleep_ms(1000);
+  play_start_tone(BUZZER_PIN);  // Sound at the start of preparation
+  brew.progress = -1;
+  brew.start_due = make_timeout_time_ms(1000);
+}
 
+static bool start_poll() {
+  while (brew.progress <= 100) {
+    if (!brew_deadline_reached(brew.start_due)) return false;
+    if (brew.progress < 0) {
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(1, 0);
+      lcd_print("STARTING PROCESS ...");
+      lcd_end_frame();
+      brew.progress = 0;
+    } else {
+      progress_bar(brew.progress, 2);
+      brew.progress += 4; // Four pixel columns: one or two cells redrawn per step
+      brew.start_due = make_timeout_time_ms(100);
+    }
+  }
+  return brew_deadline_reached(brew.start_due);
+}
+
+static void start_complete() {
+  update_led_bar(brew.pressure); // Updates the LED bar based on coffee strength
   lcd_clear();
-  lcd_set_cursor(1, 0);
-  lcd_print("STARTING PROCESS ...");
-  for (int i = 0; i <= 80; i += 10) {
-    progress_bar(i, 2);
-    sleep_ms(300);
+}
+
+// ---- HEATING ---- //
+static void heating_start() {
+  brew.current_temp_x10 = 250;
+  brew.heating_due = get_absolute_time();
+  lcd_set_cursor(0, 2);
+  lcd_print("HEATING WATER...");
+}
+
+static bool heating_poll() {
+  while (brew.current_temp_x10 <= brew.desired_temp_x10) {
+    if (!brew_deadline_reached(brew.heating_due)) return false;
+    char buffer[16];
+    char *p = fmt_text(buffer, "TEMP: ");
+    p = fmt_decimal(p, brew.current_temp_x10, 1, 1);
+    fmt_end(fmt_text(p, " C"));
+    lcd_begin_frame();
+    lcd_set_cursor(1, 4);
+    lcd_print(buffer);
+    progress_bar((brew.current_temp_x10 - 250) * 100 / (brew.desired_temp_x10 - 250), 2);
+    lcd_end_frame();
+    brew.current_temp_x10 += 25;
+    brew.heating_due = delayed_by_ms(brew.heating_due, 400);
   }
+  return brew_deadline_reached(brew.heating_due);
+}
 
-  update_led_bar(pressure); // Updates the LED bar based on coffee strength
+static void heating_complete() {
+  lcd_begin_frame();
+  lcd_set_cursor(0, 0);
+  lcd_print("   WATER READY!     ");
+  lcd_set_cursor(1, 0);
+  lcd_print("                    ");
+  progress_bar(100, 2);
+  lcd_end_frame();
+}
 
-  simulate_water_heating(desired_temp); // Simulates water heating
-  int total_water = cups * water_per_cup;
+// ---- BEANS ---- //
+static void beans_start() {
+  show_mechanics(" RELEASING BEANS... ");
+  servo_play(SERVO_COFFEE_GATE, gate_home, PATH_LENGTH(gate_home), NULL);
+  servo_play(SERVO_BEAN_GATE, gate_open, PATH_LENGTH(gate_open), gate_done);
+}
 
-  // Moves the first servo to release coffee beans
-  lcd_clear();
-  lcd_set_cursor(1, 1);
-  lcd_print("RELEASING BEANS...");
-  servo1_motion();
+static bool beans_poll() {
+  return !servo_busy(SERVO_BEAN_GATE);
+}
 
-  // Stepper motor simulates grinding coffee beans
-  lcd_clear();
-  lcd_set_cursor(1, 4);
-  lcd_print("GRINDING ...");
-  stepper_rotate(true, 5000, 5);
-  sleep_ms(500);
+static void beans_complete() {
+  servo_play(SERVO_BEAN_GATE, gate_close, PATH_LENGTH(gate_close), NULL); // Closes while grinding
+}
 
-  // Coffee extraction begins
-  int brewing_time = 5000 - (pressure * 20); // Adjusts brewing time based on pressure
+// ---- GRINDING ---- //
+// Runs from the step alarm: wakes the main loop when the grinder stops
+static void grinding_done() {
+  event_post(EVENT_ACTUATOR_STEP);
+}
+
+static void grinding_start() {
+  show_mechanics("    GRINDING ...    ");
+  stepper_move(true, GRIND_STEPS, GRIND_SPEED, GRIND_ACCEL, grinding_done);
+}
+
+static bool grinding_poll() {
+  return !stepper_busy();
+}
+
+static void grinding_complete() {
+  show_mechanics("    BEANS GROUND    ");
+}
+
+// ---- EXTRACTION ---- //
+static void extraction_start() {
+  int brewing_time = 5000 - (brew.pressure * 20); // Adjusts brewing time based on pressure
+  lcd_begin_frame();
   lcd_clear();
 
-  char temp_buffer[21];
-  snprintf(temp_buffer, sizeof(temp_buffer), "BREWING COFFEE:%s", temp_level);
   lcd_set_cursor(0, 0);
-  lcd_print(temp_buffer);
+  lcd_print("BREWING COFFEE:");
+  lcd_print(brew.temp_level);
 
   char water_buffer[21];
-  if (cups == 1) {
-    snprintf(water_buffer, sizeof(water_buffer), "1 CUP OF %d ML", water_per_cup);
-  } else {
-    snprintf(water_buffer, sizeof(water_buffer), "%d CUPS OF %d ML", cups, water_per_cup);
-  }
+  char *p = fmt_int(water_buffer, brew.cups);
+  p = fmt_text(p, brew.cups == 1 ? " CUP OF " : " CUPS OF ");
+  p = fmt_int(p, brew.water_per_cup);
+  fmt_end(fmt_text(p, " ML"));
   lcd_set_cursor(2, 0);
   lcd_print(water_buffer);
 
-  char strength_buffer[21];
-  snprintf(strength_buffer, sizeof(strength_buffer), "INTENSITY: %s", strength);
   lcd_set_cursor(3, 0);
-  lcd_print(strength_buffer);
+  lcd_print("INTENSITY: ");
+  lcd_print(brew.strength);
+  lcd_end_frame();
+
+  servo_play(SERVO_COFFEE_GATE, gate_ajar, PATH_LENGTH(gate_ajar), NULL);
+  brew.extraction_due = make_timeout_time_ms(brewing_time);
+}
+
+static bool extraction_poll() {
+  return brew_deadline_reached(brew.extraction_due);
+}
+
+static void extraction_complete() {
+  water_ml -= brew.cups * brew.water_per_cup;
+  coffee_beans_g -= brew.cups * 10;
+}
+
+// ---- RELEASE ---- //
+static void release_start() {
+  servo_play(SERVO_COFFEE_GATE, gate_open, PATH_LENGTH(gate_open), gate_done);
+}
 
-  servo2_move(45);
-  sleep_ms(brewing_time);
+static bool release_poll() {
+  return !servo_busy(SERVO_COFFEE_GATE);
+}
 
-  water_ml -= total_water;
-  coffee_beans_g -= cups * 10;
+static void release_complete() {
+  servo_play(SERVO_COFFEE_GATE, gate_close, PATH_LENGTH(gate_close), NULL); // Closes during the finish
+}
 
+// ---- FINISH ---- //
+static void finish_start() {
   // Final message on the display
-  servo2_motion();
   lcd_clear();
   fade_text("  COFFEE IS READY!", "      GRAB IT!", 1, 1000);
   play_coffee_ready(BUZZER_PIN);
   blink_led_bar(3, 300); // Blink LED bar
   gpio_put(BLUE_LED, 0);
-  sleep_ms(2000);
+  brew.finish_due = make_timeout_time_ms(3000); // The fade takes about 2 s, then "GRAB IT!" stays 1 s
+}
 
+static bool finish_poll() {
+  return brew_deadline_reached(brew.finish_due);
+}
+
+static void finish_complete() {
   display_initial_screen();
   current_state = STATE_INITIAL_SCREEN; // Return to the initial screen
+}
+
+static const BrewStage stages[BREW_STAGE_COUNT] = {
+  [BREW_STAGE_RESOURCES]  = {resources_start, resources_poll, NULL, 0},
+  [BREW_STAGE_START]      = {start_start, start_poll, start_complete, STAGE(BREW_STAGE_RESOURCES)},
+  [BREW_STAGE_HEATING]    = {heating_start, heating_poll, heating_complete, STAGE(BREW_STAGE_START)},
+  [BREW_STAGE_BEANS]      = {beans_start, beans_poll, beans_complete, STAGE(BREW_STAGE_START)},
+  [BREW_STAGE_GRINDING]   = {grinding_start, grinding_poll, grinding_complete, STAGE(BREW_STAGE_BEANS)},
+  [BREW_STAGE_EXTRACTION] = {extraction_start, extraction_poll, extraction_complete,
+                             STAGE(BREW_STAGE_HEATING) | STAGE(BREW_STAGE_GRINDING)},
+  [BREW_STAGE_RELEASE]    = {release_start, release_poll, release_complete, STAGE(BREW_STAGE_EXTRACTION)},
+  [BREW_STAGE_FINISH]     = {finish_start, finish_poll, finish_complete, STAGE(BREW_STAGE_RELEASE)},
+};
+
+// Called for the PLAY key while brewing; releases a pending refill alert
+void brew_confirm_refill() {
+  if (brew.needs_refill) brew.refill_confirmed = true;
+}
+
+// Starts a new preparation; the main loop then calls brew_poll() on every wake-up
+void brew_start(int cups) {
+  brew.cups = cups;
+  brew.pressure = read_intensity();
+  brew.desired_temp_x10 = read_desired_temperature();
+  brew.water_per_cup = read_water_quantity();
+  brew.strength = determine_coffee_strength(brew.pressure);
+  brew.temp_level = determine_temperature_level(brew.desired_temp_x10);
+  brew.started = 0;
+  brew.completed = 0;
+  brew.wake_at = at_the_end_of_time;
+  brew.brew_start_us = profile_now();
+}
+
+// Advances every active stage; returns true while the preparation is still running
+bool brew_poll() {
+  brew.wake_at = at_the_end_of_time;
+
+  bool progressed = true;
+  while (progressed) { // A completed stage may unlock others in the same pass
+    progressed = false;
+    for (int i = 0; i < BREW_STAGE_COUNT; i++) {
+      const BrewStage *stage = &stages[i];
+      uint32_t bit = STAGE(i);
+      if (brew.completed & bit) continue;
+      if (!(brew.started & bit)) {
+        if ((brew.completed & stage->after) != stage->after) continue;
+        brew.started |= bit;
+        brew.stage_start_us[i] = profile_now();
+        stage->start();
+      }
+      if (stage->poll()) {
+        brew.completed |= bit;
+        if (stage->complete) stage->complete();
+        profile_span_end(PROFILE_SPAN_BREW_STAGE, i, brew.stage_start_us[i]);
+        progressed = true;
+      }
+    }
+  }
+
+  bool running = brew.completed != ALL_STAGES;
+  if (running && !is_at_the_end_of_time(brew.wake_at)) {
+    event_schedule(EVENT_ACTUATOR_STEP, brew.wake_at);
+  } else if (!running) {
+    profile_span_end(PROFILE_SPAN_BREW, brew.cups, brew.brew_start_us);
+  }
+  return running;
+}
+
+// Runs a whole preparation to completion, sleeping between stage deadlines
+void prepare_coffee(int cups) {
+  brew_start(cups);
+  while (brew_poll()) {
+    best_effort_wfe_or_timeout(brew.wake_at); // Also wakes on the PLAY key during a refill
+    key_event key;
+    while (key_event_pop(&key)) handle_key(&key);
+  }
+  event_cancel(EVENT_ACTUATOR_STEP);
 }
\ No newline at end of file
@@ -4,10 +4,15 @@
 #ifndef INTERNAL_OPERATIONS_H
 #define INTERNAL_OPERATIONS_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void setup_machine();                                       // Initializes the machine
-void prepare_coffee(int cups);                              // Simulates the coffee preparation process
-void simulate_water_heating(float desired_temp);            // Simulates water heating
+void prepare_coffee(int cups);                              // Runs a whole preparation, blocking until it ends
+void brew_start(int cups);                                  // Starts the non-blocking brew pipeline
+bool brew_poll();                                           // Advances the pipeline; true while still brewing
+void brew_confirm_refill();                                 // PLAY pressed: the user refilled the machine
 const char* determine_coffee_strength(int pressure);        // Determines the coffee strength based on pressure
-const char* determine_temperature_level(float temperature); // Determines the coffee temperature level
+const char* determine_temperature_level(int16_t temp_x10);  // Determines the coffee temperature level (0.1 °C)
 
 #endif // INTERNAL_OPERATIONS_H
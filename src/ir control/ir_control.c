@@ -4,136 +4,151 @@
 #include "hardware/gpio.h"
 #include <string.h>
 #include <stdint.h>
+#include "hardware/sync.h"
 #include "ir_control.h"
-
-struct _ir_data ir_data;
-
-uint16_t __last_address = 0x0;
-uint16_t __last_command = 0x0;
-
-void (*user_function_callback) (uint16_t address, uint16_t command, int type) = NULL;
-
-void reset_ir_data() {
-  ir_data.cnt = 0;
-
-  size_t i = 0;
-  for (; i < 34; ++i) {
-    ir_data.rises[i] = 0;
-  }
+#include "event_loop.h"
+#include "profile.h"
+
+// Decoder state, owned by the interrupt
+static struct {
+  uint32_t last_edge; // Timestamp of the previous falling edge
+  uint8_t edges;      // Edges of the current frame seen so far
+  uint32_t raw;       // Bits received so far, LSB first
+} decoder;
+
+static Key last_key = KEY_NONE; // Used for repeat codes
+
+// Single producer (interrupt) / single consumer (thread context) ring
+static key_event queue[KEY_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+
+static ir_isr_stats isr_stats;
+
+// Key map, indexed by the NEC command byte
+static const uint8_t key_table[256] = {
+  [0xA2] = KEY_POWER,
+  [0xE2] = KEY_MENU,
+  [0x22] = KEY_TEST,
+  [0x02] = KEY_PLUS,
+  [0xC2] = KEY_BACK,
+  [0xE0] = KEY_PREVIOUS,
+  [0xA8] = KEY_PLAY,
+  [0x90] = KEY_NEXT,
+  [0x68] = KEY_0,
+  [0x98] = KEY_MINUS,
+  [0xB0] = KEY_C,
+  [0x30] = KEY_1,
+  [0x18] = KEY_2,
+  [0x7A] = KEY_3,
+  [0x10] = KEY_4,
+  [0x38] = KEY_5,
+  [0x5A] = KEY_6,
+  [0x42] = KEY_7,
+  [0x4A] = KEY_8,
+  [0x52] = KEY_9,
+};
+
+static inline bool in_window(uint32_t diff, uint32_t space) {
+  return diff > IR_WINDOW_LOW(space) && diff < IR_WINDOW_HIGH(space);
 }
 
-void process_ir_data(int type) {
-  // If it's a repeat code, just send the previous command.
-  if (type == REPEAT) {
-    user_function_callback(__last_address, __last_command, type);
+static void queue_push(Key key, bool repeat, uint32_t timestamp_us) {
+  if (key == KEY_NONE) return;
+  if ((uint8_t)(queue_head - queue_tail) >= KEY_QUEUE_SIZE) {
+    isr_stats.dropped++;
     return;
   }
+  queue[queue_head & (KEY_QUEUE_SIZE - 1)] = (key_event) {key, repeat, timestamp_us};
+  __compiler_memory_barrier(); // The record must be stored before the new head
+  queue_head++;
+  event_post(EVENT_INPUT);
+}
 
-  uint64_t diff;
-  uint32_t raw = 0x0;
-
-  size_t i = 2;
-  for (; i < 34; ++i) {
-    // Compute differences between pulses
-    diff = ir_data.rises[i] - ir_data.rises[i - 1];
-
-    // Should be a zero
-    if (diff > 0.85 * ZERO_SPACE && diff < 1.15 * ZERO_SPACE)
-      raw >>= 1;
-    // Should be a one
-    else if (diff > 0.85 * ONE_SPACE && diff < 1.15 * ONE_SPACE) {
-      raw >>= 1;
-      raw |= 0x80000000;
-    }
-    // Bad transmission
-    else {
-      return;
-    }
-  }
-
-  // Use a union for bit access
-  union {
-    uint32_t raw;
-    struct {
-      uint8_t adr, inv_adr, cmd, inv_cmd;
-    };
-  } data;
-
-  data.raw = raw;
+// Error checking defined by the NEC protocol: address and command are sent with their inverses
+static void frame_complete(uint32_t raw, uint32_t timestamp_us) {
+  uint8_t adr = raw & 0xFF;
+  uint8_t inv_adr = (raw >> 8) & 0xFF;
+  uint8_t cmd = (raw >> 16) & 0xFF;
+  uint8_t inv_cmd = (raw >> 24) & 0xFF;
 
-  // Error checking defined by the NEC protocol
-  if (data.adr != (data.inv_adr ^ 0xff) || data.cmd != (data.inv_cmd ^ 0xff)) {
+  if ((adr ^ inv_adr) != 0xff || (cmd ^ inv_cmd) != 0xff) {
     return;
   }
 
-  __last_address = data.adr;
-  __last_command = data.cmd;
-  user_function_callback(data.adr, data.cmd, NORMAL);
+  last_key = get_key(cmd);
+  queue_push(last_key, false, timestamp_us);
 }
 
+// Constant work per edge: one subtraction and a few integer compares, no display or user code
 void irq_callback(uint gpio, uint32_t events) {
-  uint64_t current_time = time_us_64();
-
-  // The space between the pulses is too big
-  if (ir_data.cnt > 0) {
-    uint64_t diff = current_time - ir_data.rises[ir_data.cnt - 1];
-
-    // Check if this is a bad message
-    if (diff > MAXIMUM_SPACE) {
-      reset_ir_data();
-      ir_data.rises[0] = current_time;
+  uint32_t current_time = time_us_32();
+  uint32_t diff = current_time - decoder.last_edge;
+  decoder.last_edge = current_time;
+
+  if (decoder.edges == 0 || diff > MAXIMUM_SPACE) {
+    decoder.edges = 1; // This edge may be a leader
+  } else if (decoder.edges == 1) {
+    if (in_window(diff, REPEAT_SPACE)) {
+      queue_push(last_key, true, current_time);
+    } else if (in_window(diff, LEADER_SPACE)) {
+      decoder.raw = 0;
+      decoder.edges = 2;
     }
-    // Check if it is a repeat message
-    else if (ir_data.cnt == 1 && diff > 0.85 * REPEAT_SPACE && diff < 1.15 * REPEAT_SPACE) {
-      process_ir_data(REPEAT);
-      reset_ir_data();
+    // Anything else: this edge becomes the new leader candidate
+  } else if (in_window(diff, ZERO_SPACE) || in_window(diff, ONE_SPACE)) {
+    // Should be a zero or a one
+    decoder.raw = (decoder.raw >> 1) | (diff > IR_WINDOW_LOW(ONE_SPACE) ? 0x80000000 : 0);
+    if (++decoder.edges == IR_FRAME_EDGES) {
+      frame_complete(decoder.raw, current_time);
+      decoder.edges = 0;
     }
+  } else {
+    decoder.edges = 1; // Bad transmission: this edge may start a new frame
   }
 
-  ir_data.rises[ir_data.cnt++] = current_time;
-
-  // The transmission ended
-  if (ir_data.cnt == 34) {
-    process_ir_data(NORMAL);
-    reset_ir_data();
-  }
+  uint32_t elapsed = time_us_32() - current_time;
+  profile_count(PROFILE_COUNT_IR_IRQS, 1);
+  isr_stats.calls++;
+  isr_stats.total_us += elapsed;
+  if (elapsed > isr_stats.max_us) isr_stats.max_us = elapsed;
 }
 
-void init_ir_irq_receiver(uint gpio, void (*callback) (uint16_t address, uint16_t command, int type))
+void init_ir_irq_receiver(uint gpio)
 {
-  // Init the ir_data struct
-  reset_ir_data();
-
-  // Set the user callback function
-  user_function_callback = callback;
+  // Init the decoder
+  decoder.edges = 0;
 
   // Init the sdk
   gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_FALL, true, &irq_callback);
 }
 
-// Key map
-const char* get_key_name(uint16_t command) {
-  switch (command) {
-    case 0x00A2: return "POWER";
-    case 0x00E2: return "MENU";
-    case 0x0022: return "TEST";
-    case 0x0002: return "+";
-    case 0x00C2: return "BACK";
-    case 0x00E0: return "PREVIOUS";
-    case 0x00A8: return "PLAY";
-    case 0x0090: return "NEXT";
-    case 0x0068: return "0";
-    case 0x0098: return "-";
-    case 0x00B0: return "C";
-    case 0x0030: return "1";
-    case 0x0018: return "2";
-    case 0x007A: return "3";
-    case 0x0010: return "4";
-    case 0x0038: return "5";
-    case 0x005A: return "6";
-    case 0x0042: return "7";
-    case 0x004A: return "8";
-    case 0x0052: return "9";
-    default: return "Invalid key";
+bool key_event_pop(key_event *event) {
+  if (queue_tail == queue_head) return false;
+  *event = queue[queue_tail & (KEY_QUEUE_SIZE - 1)];
+  __compiler_memory_barrier(); // The copy must be done before the slot is freed
+  queue_tail++;
+  return true;
+}
+
+// The interrupt posts an event (SEV) after queueing, so WFE cannot miss a press
+Key key_wait_press(absolute_time_t deadline) {
+  key_event event;
+  while (true) {
+    while (key_event_pop(&event)) {
+      if (!event.repeat) return event.key;
+    }
+    if (best_effort_wfe_or_timeout(deadline)) return KEY_NONE;
   }
+}
+
+ir_isr_stats ir_get_isr_stats() {
+  uint32_t irq_state = save_and_disable_interrupts();
+  ir_isr_stats copy = isr_stats;
+  restore_interrupts(irq_state);
+  return copy;
+}
+
+Key get_key(uint8_t command) {
+  return (Key)key_table[command];
 }
\ No newline at end of file
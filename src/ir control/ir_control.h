@@ -1,6 +1,9 @@
 // ir_control.h
 
 // Header for the NEC infrared protocol. Used only for receiving.
+// The GPIO interrupt decodes one edge at a time with integer timing windows,
+// maps the command to a Key through a lookup table and queues a key_event.
+// The application drains the queue from thread context.
 #include <string.h>
 #include <stdint.h>
 #include "pico/stdlib.h"
@@ -9,40 +12,62 @@
 #ifndef IR_CONTROL_H
 #define IR_CONTROL_H
 
-#define NORMAL 1
-#define REPEAT 2
-
+#define LEADER_SPACE  13500
 #define ZERO_SPACE     1125
 #define ONE_SPACE      2250
 #define MAXIMUM_SPACE 15000
 #define REPEAT_SPACE  11250
 
-// Representation of the pulses by time in microseconds.
-struct _ir_data {
-  size_t cnt; // Used for keeping track of pulse length.
-  uint64_t rises[34]; // Used for keeping track of timings. Has time of each pulse in microseconds.
-};
+// Accepted timing window: +/-15% around the nominal space, in whole microseconds
+#define IR_WINDOW_LOW(space)  ((space) * 85 / 100)
+#define IR_WINDOW_HIGH(space) ((space) * 115 / 100)
 
-extern struct _ir_data ir_data;
+#define IR_FRAME_EDGES 34 // Leader, 32 data bits, stop mark
+#define KEY_QUEUE_SIZE  8 // Key events waiting to be handled (power of two)
 
-// Used for repeat codes
-extern uint16_t __last_address;
-extern uint16_t __last_command;
+// Remote control buttons; digits are contiguous so key - KEY_0 is the value
+typedef enum {
+  KEY_NONE,
+  KEY_POWER,
+  KEY_MENU,
+  KEY_TEST,
+  KEY_PLUS,
+  KEY_BACK,
+  KEY_PREVIOUS,
+  KEY_PLAY,
+  KEY_NEXT,
+  KEY_MINUS,
+  KEY_C,
+  KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9,
+} Key;
 
-//The user's function.
-extern void (*user_function_callback) (uint16_t address, uint16_t command, int type);
+#define key_is_digit(key) ((key) >= KEY_0 && (key) <= KEY_9)
+#define key_digit(key)    ((uint8_t)((key) - KEY_0))
 
-//reset the ir_data struct
-void reset_ir_data();
+// One press (or repeat code while the button is held), as queued by the interrupt
+typedef struct {
+  Key key;
+  bool repeat;
+  uint32_t timestamp_us; // time_us_32() at the last edge of the frame
+} key_event;
 
-//type Type of processing. Can be REPEAT or NORMAL.
-//Function that computes the differences between rises and decodes them.
-void process_ir_data(int type);
+// Interrupt handler cost, measured with the microsecond timer
+typedef struct {
+  uint32_t calls;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t dropped; // Events lost because the queue was full
+} ir_isr_stats;
 
-//Function called automatically by the irq. Used for triggering the processing.
+//Function called automatically by the irq. Decodes the edge and queues finished frames.
 void irq_callback(uint gpio, uint32_t events);
-void init_ir_irq_receiver(uint gpio, void (*callback) (uint16_t address, uint16_t command, int type));
+void init_ir_irq_receiver(uint gpio);
+
+// Key queue: single producer (the interrupt), single consumer (thread context)
+bool key_event_pop(key_event *event);        // False if the queue is empty
+Key key_wait_press(absolute_time_t deadline); // Sleeps until a new press (repeats skipped); KEY_NONE on timeout
+ir_isr_stats ir_get_isr_stats();
 
-const char* get_key_name(uint16_t command);
+Key get_key(uint8_t command); // Constant-time command lookup; KEY_NONE for unknown buttons
 
 #endif // IR_CONTROL_H
\ No newline at end of file
@@ -0,0 +1,141 @@
+// display_task.c
+
+#include "display_task.h"
+#include "lcd_animation.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+// Single producer (core 0) / single consumer (core 1) ring
+static display_command queue[DISPLAY_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+static volatile bool running = false;
+
+static display_task_stats stats;
+
+static void run_command(const display_command *command) {
+  const int16_t *a = command->args;
+  switch (command->op) {
+    case DISPLAY_INIT:
+      lcd_init();
+      break;
+    case DISPLAY_CLEAR:
+      lcd_clear();
+      break;
+    case DISPLAY_SET_CURSOR:
+      lcd_set_cursor(a[0], a[1]);
+      break;
+    case DISPLAY_PRINT:
+      lcd_print(command->text);
+      break;
+    case DISPLAY_CHAR:
+      lcd_send_char((char)a[0]);
+      break;
+    case DISPLAY_FLUSH:
+      lcd_flush();
+      break;
+    case DISPLAY_BEGIN_FRAME:
+      lcd_begin_frame();
+      break;
+    case DISPLAY_END_FRAME:
+      lcd_end_frame();
+      break;
+    case DISPLAY_CUSTOM_CHAR:
+      create_custom_char(a[0], (uint8_t *)command->text);
+      break;
+    case DISPLAY_PRINT_AT:
+      lcd_print_at(a[0], a[1], command->text);
+      break;
+    case DISPLAY_STOP_ANIM:
+      if (a[1]) {
+        lcd_finish_animation(a[0]);
+      } else {
+        lcd_cancel_animation(a[0]);
+      }
+      break;
+    case DISPLAY_SCROLL:
+      scroll_text(command->text, a[0], a[1]);
+      break;
+    case DISPLAY_TYPE:
+      type_effect(command->text, a[0], a[1]);
+      break;
+    case DISPLAY_PROGRESS:
+      progress_bar(a[0], a[1]);
+      break;
+    case DISPLAY_BLINK:
+      blink_text(command->text, a[0], a[1], a[2], a[3]);
+      break;
+    case DISPLAY_FADE:
+      fade_text(command->text, command->text + strlen(command->text) + 1, a[0], a[1]);
+      break;
+    case DISPLAY_CLOCK:
+      simple_clock();
+      break;
+    case DISPLAY_POWER:
+      lcd_set_power(a[0]);
+      break;
+  }
+}
+
+// Core 1: draws the animation steps that are due, then sleeps until the next one or until
+// core 0 queues something (it signals with SEV after every command)
+static void display_core_entry() {
+  multicore_lockout_victim_init(); // Lets flash writes on core 0 park this core
+  while (true) {
+    absolute_time_t next_frame = lcd_animation_tick();
+    if (queue_tail == queue_head) {
+      best_effort_wfe_or_timeout(next_frame);
+      continue;
+    }
+    run_command(&queue[queue_tail & (DISPLAY_QUEUE_SIZE - 1)]);
+    queue_tail++; // Frees the slot only once the command is drawn
+    __sev();      // Wakes core 0 if it is waiting for room
+  }
+}
+
+// The LCD must already be initialized: core 0 hands it over from here on
+void display_task_start() {
+  if (running) return;
+  running = true;
+  multicore_launch_core1(display_core_entry);
+}
+
+bool display_task_running() {
+  return running;
+}
+
+bool display_task_forwarding() {
+  return running && get_core_num() == 0;
+}
+
+void display_task_queue(const display_command *command) {
+  uint8_t depth = queue_head - queue_tail;
+  if (depth >= DISPLAY_QUEUE_SIZE) {
+    stats.full_waits++;
+    while ((uint8_t)(queue_head - queue_tail) >= DISPLAY_QUEUE_SIZE) {
+      __wfe();
+    }
+  }
+  queue[queue_head & (DISPLAY_QUEUE_SIZE - 1)] = *command;
+  __dmb();       // The command must be visible before the new head
+  queue_head++;
+  __sev();
+
+  stats.commands++;
+  depth = queue_head - queue_tail;
+  if (depth > stats.max_depth) stats.max_depth = depth;
+}
+
+// Core 1 signals with SEV after every command it finishes
+void display_task_sync() {
+  if (!display_task_forwarding()) return;
+  while (queue_tail != queue_head) {
+    __wfe();
+  }
+}
+
+display_task_stats display_task_get_stats() {
+  return stats;
+}
@@ -0,0 +1,62 @@
+// display_task.h
+
+// Core 1 display task:
+// - Owns the LCD (and its side of the shared I2C bus) once started
+// - Takes render commands from core 0 through a lock-free single producer/single consumer ring
+// - Ticks the animation engine (lcd_animation.h) between commands, sleeping until the next
+//   frame is due or a command arrives
+//
+// The lcd_* functions forward themselves here when called on core 0, so callers do not change.
+// Commands are drawn in the order they were queued.
+
+#ifndef DISPLAY_TASK_H
+#define DISPLAY_TASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lcd_i2c.h"
+
+#define DISPLAY_QUEUE_SIZE 32                      // Must be a power of two
+#define DISPLAY_TEXT_SIZE (LCD_ROWS * LCD_COLS + 4) // Longer text is cut
+
+typedef enum {
+  DISPLAY_INIT,
+  DISPLAY_CLEAR,
+  DISPLAY_SET_CURSOR,  // row, col
+  DISPLAY_PRINT,       // text
+  DISPLAY_CHAR,        // char
+  DISPLAY_FLUSH,
+  DISPLAY_BEGIN_FRAME,
+  DISPLAY_END_FRAME,
+  DISPLAY_CUSTOM_CHAR, // location, 8 row bitmaps in text
+  DISPLAY_PRINT_AT,    // row, col, text
+  DISPLAY_STOP_ANIM,   // row, finish
+  DISPLAY_SCROLL,      // text, row, delay
+  DISPLAY_TYPE,        // text, row, delay
+  DISPLAY_PROGRESS,    // percentage, row
+  DISPLAY_BLINK,       // text, row, col, times, delay
+  DISPLAY_FADE,        // two texts, row, delay
+  DISPLAY_CLOCK,
+  DISPLAY_POWER,       // on
+} display_op;
+
+typedef struct {
+  display_op op;
+  int16_t args[4];
+  char text[DISPLAY_TEXT_SIZE]; // DISPLAY_FADE: the second string follows the first terminator
+} display_command;
+
+typedef struct {
+  uint32_t commands;   // Commands queued by core 0
+  uint32_t full_waits; // Times core 0 had to wait for a free slot
+  uint8_t max_depth;   // Deepest the queue has been
+} display_task_stats;
+
+void display_task_start();                           // Hands the LCD over to core 1
+bool display_task_running();                         // True once core 1 owns the LCD
+bool display_task_forwarding();                      // True on core 0 once core 1 owns the LCD
+void display_task_queue(const display_command *command); // Waits for a free slot when the queue is full
+void display_task_sync();                            // Waits until core 1 has drawn everything queued
+display_task_stats display_task_get_stats();
+
+#endif // DISPLAY_TASK_H
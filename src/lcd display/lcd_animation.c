@@ -0,0 +1,157 @@
+// lcd_animation.c
+
+#include "lcd_animation.h"
+#include "display_task.h"
+#include "lcd_format.h"
+#include <string.h>
+
+#define STEP_DONE -1
+#define FADE_ERASE_MS 50 // Between two erased characters
+
+static lcd_animation effects[LCD_ROWS];
+
+// Blanks len cells from col, clipped to the row
+static void erase(int row, int col, int len) {
+  char blank[LCD_COLS + 1];
+  if (len > LCD_COLS - col) len = LCD_COLS - col;
+  if (len <= 0) return;
+  fmt_end(fmt_repeat(blank, ' ', len));
+  lcd_print_at(row, col, blank);
+}
+
+// ---------------------------------- Effects ---------------------------------- //
+// Each step draws one instant of the effect and returns the delay to the next one (ms)
+
+static int type_step(lcd_animation *a) {
+  int len = strlen(a->text);
+  if (a->step >= len) return STEP_DONE;
+  char c[2] = {a->text[a->step], '\0'};
+  lcd_print_at(a->row, a->col + a->step, c);
+  return ++a->step < len ? a->interval_ms : STEP_DONE;
+}
+
+// Even steps show the text, odd steps erase it; the last step leaves it shown
+static int blink_step(lcd_animation *a) {
+  if (a->step & 1) {
+    erase(a->row, a->col, strlen(a->text));
+  } else {
+    lcd_print_at(a->row, a->col, a->text);
+  }
+  return a->step++ < 2 * a->count ? a->interval_ms : STEP_DONE;
+}
+
+// Step 0 shows text, steps 1..len+1 erase it from the end, the last one shows text2
+static int fade_step(lcd_animation *a) {
+  int len = strlen(a->text);
+  if (a->step == 0) {
+    lcd_print_at(a->row, 0, a->text);
+    a->step++;
+    return a->hold_ms;
+  }
+  if (a->step <= len + 1) {
+    erase(a->row, len - (a->step - 1), 1);
+    a->step++;
+    return FADE_ERASE_MS;
+  }
+  lcd_print_at(a->row, 0, a->text2);
+  return STEP_DONE;
+}
+
+// Slides one character per step until the end of the text shows, then starts over
+static int scroll_step(lcd_animation *a) {
+  int len = strlen(a->text);
+  if (len <= LCD_COLS) {
+    lcd_print_at(a->row, 0, a->text);
+    return STEP_DONE;
+  }
+  lcd_print_at(a->row, 0, a->text + a->step); // Clipped to the row
+  a->step = (a->step + 1) % (len - LCD_COLS + 1);
+  return a->interval_ms;
+}
+
+static int clock_step(lcd_animation *a) {
+  char time[LCD_COLS + 1];
+  char *p = fmt_text(time, "Time: ");
+  p = fmt_uint(p, a->step, 3, '0');
+  fmt_end(fmt_text(p, " sec"));
+  lcd_print_at(a->row, 0, time);
+  return ++a->step < a->count ? a->interval_ms : STEP_DONE;
+}
+
+static int run_step(lcd_animation *a) {
+  switch (a->kind) {
+    case LCD_ANIMATION_TYPE:   return type_step(a);
+    case LCD_ANIMATION_BLINK:  return blink_step(a);
+    case LCD_ANIMATION_FADE:   return fade_step(a);
+    case LCD_ANIMATION_SCROLL: return scroll_step(a);
+    case LCD_ANIMATION_CLOCK:  return clock_step(a);
+    default:                   return STEP_DONE;
+  }
+}
+
+// What the effect leaves on screen when it runs to the end
+static void draw_end_state(const lcd_animation *a) {
+  switch (a->kind) {
+    case LCD_ANIMATION_TYPE:
+    case LCD_ANIMATION_BLINK:
+      lcd_print_at(a->row, a->col, a->text);
+      break;
+    case LCD_ANIMATION_FADE:
+      erase(a->row, 0, strlen(a->text));
+      lcd_print_at(a->row, 0, a->text2);
+      break;
+    case LCD_ANIMATION_SCROLL:
+      lcd_print_at(a->row, 0, a->text);
+      break;
+    default:
+      break; // The clock stays where it is
+  }
+}
+
+// ---------------------------------- Engine ---------------------------------- //
+void lcd_animation_start(const lcd_animation *animation) {
+  if (animation->row >= LCD_ROWS) return;
+  lcd_animation *a = &effects[animation->row];
+  *a = *animation;
+  a->step = 0;
+  a->due = get_absolute_time();
+  // Nothing ticks the engine before the display task runs: show the end state right away
+  if (!display_task_running()) lcd_animation_stop(a->row, true);
+}
+
+void lcd_animation_stop(int row, bool finish) {
+  lcd_begin_frame();
+  for (int r = 0; r < LCD_ROWS; r++) {
+    if ((row != LCD_ALL_ROWS && r != row) || effects[r].kind == LCD_ANIMATION_NONE) continue;
+    if (finish) draw_end_state(&effects[r]);
+    effects[r].kind = LCD_ANIMATION_NONE;
+  }
+  lcd_end_frame();
+}
+
+bool lcd_animation_running(int row) {
+  return row >= 0 && row < LCD_ROWS && effects[row].kind != LCD_ANIMATION_NONE;
+}
+
+// Steps are scheduled from their previous deadline, so a slow flush does not stretch the effect
+absolute_time_t lcd_animation_tick() {
+  absolute_time_t now = get_absolute_time();
+  absolute_time_t next = at_the_end_of_time;
+
+  lcd_begin_frame();
+  for (int r = 0; r < LCD_ROWS; r++) {
+    lcd_animation *a = &effects[r];
+    if (a->kind == LCD_ANIMATION_NONE) continue;
+    if (absolute_time_diff_us(a->due, now) >= 0) {
+      int delay_ms = run_step(a);
+      if (delay_ms == STEP_DONE) {
+        a->kind = LCD_ANIMATION_NONE;
+        continue;
+      }
+      a->due = delayed_by_ms(a->due, delay_ms);
+    }
+    if (absolute_time_diff_us(a->due, next) > 0) next = a->due;
+  }
+  lcd_end_frame();
+  return next;
+}
@@ -0,0 +1,52 @@
+// lcd_animation.h
+
+// Timeline engine behind the LCD animations (typing, blinking, fading, scrolling, clock):
+// - Each running effect is a small object holding its text, its step and when the next step is due
+// - One effect per row; effects on different rows run at the same time
+// - Ticked on the core that owns the LCD (the display task loop), never with sleep_ms()
+// - A tick draws every step that came due into one frame, so one flush covers all rows
+//
+// Callers use the effect functions of lcd_i2c.h, which start an effect and return at once,
+// and lcd_cancel_animation()/lcd_finish_animation() to stop one early.
+
+#ifndef LCD_ANIMATION_H
+#define LCD_ANIMATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "lcd_i2c.h"
+
+#define LCD_ANIMATION_TEXT_SIZE 64 // Longer scroll messages are cut
+
+typedef enum {
+  LCD_ANIMATION_NONE,
+  LCD_ANIMATION_TYPE,   // One more character every interval
+  LCD_ANIMATION_BLINK,  // Shown and erased `count` times, then left shown
+  LCD_ANIMATION_FADE,   // text held for hold_ms, erased from the end, then replaced by text2
+  LCD_ANIMATION_SCROLL, // Window sliding over a long text, wrapping until stopped
+  LCD_ANIMATION_CLOCK,  // Seconds counter, `count` ticks
+} lcd_animation_kind;
+
+typedef struct {
+  lcd_animation_kind kind;
+  uint8_t row;
+  uint8_t col;
+  uint16_t interval_ms;
+  uint16_t hold_ms;
+  uint16_t count;
+  char text[LCD_ANIMATION_TEXT_SIZE];
+  char text2[LCD_COLS + 1];
+
+  // Filled in by the engine
+  uint16_t step;
+  absolute_time_t due;
+} lcd_animation;
+
+// These run on the core that owns the LCD
+void lcd_animation_start(const lcd_animation *animation); // Replaces the effect on its row
+void lcd_animation_stop(int row, bool finish);           // finish draws the end state; row LCD_ALL_ROWS stops all
+bool lcd_animation_running(int row);
+absolute_time_t lcd_animation_tick();                     // Draws the steps that are due; returns when the next one is
+
+#endif // LCD_ANIMATION_H
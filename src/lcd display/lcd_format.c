@@ -0,0 +1,69 @@
+// lcd_format.c
+
+#include "lcd_format.h"
+
+static const uint32_t powers_of_ten[] = {1, 10, 100, 1000, 10000, 100000};
+
+char *fmt_text(char *out, const char *text) {
+  while (*text) *out++ = *text++;
+  return out;
+}
+
+char *fmt_repeat(char *out, char c, int count) {
+  while (count-- > 0) *out++ = c;
+  return out;
+}
+
+// Digits are produced backwards into a scratch buffer, then padded and copied
+char *fmt_uint(char *out, uint32_t value, uint8_t width, char pad) {
+  char digits[10];
+  int len = 0;
+  do {
+    digits[len++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  out = fmt_repeat(out, pad, width - len);
+  while (len > 0) *out++ = digits[--len];
+  return out;
+}
+
+char *fmt_int(char *out, int32_t value) {
+  if (value < 0) {
+    *out++ = '-';
+    return fmt_uint(out, -(uint32_t)value, 0, ' ');
+  }
+  return fmt_uint(out, (uint32_t)value, 0, ' ');
+}
+
+// 875 ml with scale 3 and 2 decimals prints "0.88"; a value that rounds to zero has no sign
+char *fmt_decimal(char *out, int32_t value, uint8_t scale, uint8_t decimals) {
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  uint32_t drop = powers_of_ten[scale - decimals];
+  magnitude = (magnitude + drop / 2) / drop;
+
+  if (value < 0 && magnitude != 0) *out++ = '-';
+  uint32_t unit = powers_of_ten[decimals];
+  out = fmt_uint(out, magnitude / unit, 0, ' ');
+  if (decimals > 0) {
+    *out++ = '.';
+    out = fmt_uint(out, magnitude % unit, decimals, '0');
+  }
+  return out;
+}
+
+char *fmt_time(char *out, uint8_t hour, uint8_t minute) {
+  out = fmt_uint(out, hour, 2, '0');
+  *out++ = ':';
+  return fmt_uint(out, minute, 2, '0');
+}
+
+char *fmt_date(char *out, uint8_t day, uint8_t month) {
+  out = fmt_uint(out, day, 2, '0');
+  *out++ = '/';
+  return fmt_uint(out, month, 2, '0');
+}
+
+void fmt_end(char *out) {
+  *out = '\0';
+}
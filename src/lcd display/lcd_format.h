@@ -0,0 +1,30 @@
+// lcd_format.h
+
+// Allocation-free text formatting for the display, in place of snprintf:
+// - Integers, right-aligned in a fixed width with space or zero padding
+// - Fixed-point decimals (values kept in tenths, millilitres, ...) rounded half away from zero
+// - Zero-padded HH:MM and DD/MM fields
+//
+// Each function writes at out and returns the position after the last character,
+// so fields chain into one buffer; fmt_end() adds the terminator:
+//   char *p = fmt_text(buffer, "TEMP: ");
+//   p = fmt_decimal(p, temp_x10, 1, 1);
+//   fmt_end(p);
+// Nothing is bounds-checked: buffers are sized for the widest field, like the LCD rows they fill.
+
+#ifndef LCD_FORMAT_H
+#define LCD_FORMAT_H
+
+#include <stdint.h>
+
+char *fmt_text(char *out, const char *text);
+char *fmt_repeat(char *out, char c, int count);
+char *fmt_uint(char *out, uint32_t value, uint8_t width, char pad); // width 0: no padding
+char *fmt_int(char *out, int32_t value);
+// value holds `scale` implied decimal digits; prints `decimals` of them (decimals <= scale)
+char *fmt_decimal(char *out, int32_t value, uint8_t scale, uint8_t decimals);
+char *fmt_time(char *out, uint8_t hour, uint8_t minute); // HH:MM
+char *fmt_date(char *out, uint8_t day, uint8_t month);   // DD/MM
+void fmt_end(char *out);
+
+#endif // LCD_FORMAT_H
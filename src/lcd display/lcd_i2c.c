@@ -8,53 +8,203 @@
   0x06 - Increment cursor (shift right)*/
 
 #include "lcd_i2c.h"
-#include "hardware/i2c.h"
+#include "display_task.h"
+#include "lcd_animation.h"
+#include "lcd_format.h"
+#include "i2c_bus.h"
+#include "profile.h"
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include <string.h>
 
-// I2C communication for the LCD display and RTC
-#define I2C_PORT i2c0
-#define SDA_PIN 4
-#define SCL_PIN 5
-static i2c_inst_t *i2c_instance;
+// PCF8574 control bits sent with every nibble: RS selects data, E latches, P3 lights the backlight
+#define LCD_RS        0x01
+#define LCD_ENABLE    0x04
+#define LCD_BACKLIGHT 0x08
+#define LCD_MODE_COMMAND 0x00
+#define LCD_MODE_DATA    LCD_RS
+#define LCD_FRAMES_PER_BYTE 4
+// Room for a full-screen flush: 80 characters plus a cursor command per group
+#define LCD_STREAM_SIZE ((LCD_ROWS * LCD_COLS * 3 / 2) * LCD_FRAMES_PER_BYTE)
+
+/* Outgoing expander frames are queued in one buffer and written in a single
+   I2C transaction (START, address, N bytes, STOP) instead of one per byte. */
+static uint8_t stream[LCD_STREAM_SIZE];
+static size_t stream_len = 0;
+static uint32_t stream_sent = 0; // Bytes ever sent, for the flush profile
+static uint8_t backlight = LCD_BACKLIGHT; // Held on every frame, including the E-low ones
+
+static void stream_send() {
+  if (stream_len == 0) return;
+  i2c_bus_write(I2C_DEVICE_LCD, stream, stream_len);
+  stream_sent += stream_len;
+  stream_len = 0;
+}
 
-/*Sends a command to the LCD over I2C in 4-bit mode
-  The command is split into two nibbles (upper and lower) since
+/*Queues a byte for the LCD in 4-bit mode
+  The byte is split into two nibbles (upper and lower) since
   the LCD controller only processes 4 bits at a time.
+  Each nibble is latched by raising and then dropping the enable signal.
   This is required for compatibility with the I2C expander module.*/
+static void stream_byte(uint8_t value, uint8_t mode) {
+  if (stream_len + LCD_FRAMES_PER_BYTE > LCD_STREAM_SIZE) {
+    stream_send();
+  }
+  uint8_t upper = (value & 0xF0) | mode | backlight;
+  uint8_t lower = ((value << 4) & 0xF0) | mode | backlight;
+
+  stream[stream_len++] = upper | LCD_ENABLE; // Sends enable signal
+  stream[stream_len++] = upper;              // Disables enable signal
+  stream[stream_len++] = lower | LCD_ENABLE; // Sends enable signal
+  stream[stream_len++] = lower;              // Disables enable signal
+}
+
+// Sends a command to the LCD right away
 static void lcd_send_command(uint8_t cmd) {
-  uint8_t upper = cmd & 0xF0;
-  uint8_t lower = (cmd << 4) & 0xF0;
+  stream_byte(cmd, LCD_MODE_COMMAND);
+  stream_send();
+}
 
-  uint8_t data[4] = {
-    upper | 0x0C, // Sends enable signal
-    upper,        // Disables enable signal
-    lower | 0x0C, // Sends enable signal
-    lower         // Disables enable signal
-  };
+// ---------------------------------- Display Task Forwarding ---------------------------------- //
+/* Once the display task runs, core 1 owns the LCD: a call made on core 0 is
+   queued as a command and returns at once, and core 1 runs the same function. */
+static bool forward(display_op op, int a0, int a1, int a2, int a3, const char *text, const char *text2) {
+  if (!display_task_forwarding()) return false;
+
+  display_command command = {op, {a0, a1, a2, a3}, {0}};
+  size_t len = 0;
+  if (text != NULL) {
+    strncpy(command.text, text, DISPLAY_TEXT_SIZE - 1);
+    len = strlen(command.text) + 1;
+  }
+  if (text2 != NULL && len < DISPLAY_TEXT_SIZE) {
+    strncpy(command.text + len, text2, DISPLAY_TEXT_SIZE - 1 - len);
+  }
+  display_task_queue(&command);
+  return true;
+}
 
-  i2c_write_blocking(i2c_instance, LCD_ADDR, data, sizeof(data), false);
+static inline bool forward_op(display_op op) {
+  return forward(op, 0, 0, 0, 0, NULL, NULL);
 }
 
-// Writes a character to the LCD
-void lcd_send_char(char c) {
-  uint8_t upper = c & 0xF0;
-  uint8_t lower = (c << 4) & 0xF0;
+// ---------------------------------- Shadow Framebuffer ---------------------------------- //
+/* Text output goes to a RAM copy of the 80 cells (frame); glass mirrors what
+   the panel is showing. lcd_flush() sends only the cells that differ, one
+   cursor command per group of adjacent changes, all in one I2C transaction.
+   Outside of an
+   lcd_begin_frame()/lcd_end_frame() pair every write is flushed immediately. */
+static const uint8_t row_offsets[LCD_ROWS] = {0x00, 0x40, 0x14, 0x54};
+static uint8_t frame[LCD_ROWS][LCD_COLS];
+static uint8_t glass[LCD_ROWS][LCD_COLS];
+static int cursor_row = 0;
+static int cursor_col = 0;
+static int glass_addr = -1; // Address counter of the controller, -1 when unknown
+static int frame_depth = 0;
+static bool progress_glyphs_loaded = false; // CGRAM holds the progress bar glyphs
+
+// Moves the cursor to the next cell, following the controller's DDRAM order (row 0 -> 2 -> 1 -> 3)
+static void advance_cursor() {
+  static const uint8_t next_row[LCD_ROWS] = {2, 3, 1, 0};
+  if (++cursor_col >= LCD_COLS) {
+    cursor_col = 0;
+    cursor_row = next_row[cursor_row];
+  }
+}
+
+static bool frame_is_blank() {
+  for (int r = 0; r < LCD_ROWS; r++) {
+    for (int c = 0; c < LCD_COLS; c++) {
+      if (frame[r][c] != ' ') return false;
+    }
+  }
+  return true;
+}
+
+static void flush_run(int row, int start, int end) {
+  int addr = row_offsets[row] + start;
+  if (addr != glass_addr) {
+    stream_byte(0x80 | addr, LCD_MODE_COMMAND);
+  }
+  for (int c = start; c < end; c++) {
+    stream_byte(frame[row][c], LCD_MODE_DATA);
+    glass[row][c] = frame[row][c];
+  }
+  glass_addr = addr + (end - start);
+}
 
-  uint8_t data[4] = {
-    upper | 0x0D, // Sends enable signal
-    upper,        // Disables enable signal
-    lower | 0x0D, // Sends enable signal
-    lower         // Disables enable signal
-  };
+// Sends the cells that changed since the last flush
+void lcd_flush() {
+  if (forward_op(DISPLAY_FLUSH)) return;
+  int dirty = 0;
+  for (int r = 0; r < LCD_ROWS; r++) {
+    dirty += memcmp(frame[r], glass[r], LCD_COLS) != 0;
+  }
+  if (dirty == 0) return;
+  uint32_t start = profile_now();
+  uint32_t sent = stream_sent;
+
+  // Blanking several rows is cheaper with the clear command than cell by cell
+  if (dirty > 1 && frame_is_blank()) {
+    lcd_send_command(0x01);
+    sleep_ms(2);
+    memset(glass, ' ', sizeof(glass));
+    glass_addr = 0;
+    profile_span_end(PROFILE_SPAN_LCD_FLUSH, stream_sent - sent, start);
+    return;
+  }
 
-  i2c_write_blocking(i2c_instance, LCD_ADDR, data, sizeof(data), false);
+  for (int r = 0; r < LCD_ROWS; r++) {
+    int c = 0;
+    while (c < LCD_COLS) {
+      if (frame[r][c] == glass[r][c]) {
+        c++;
+        continue;
+      }
+      // Extends the group over single unchanged cells: rewriting one cell costs
+      // the same as a new cursor command
+      int end = c + 1;
+      while (end < LCD_COLS) {
+        if (frame[r][end] != glass[r][end]) {
+          end++;
+        } else if (end + 1 < LCD_COLS && frame[r][end + 1] != glass[r][end + 1]) {
+          end += 2;
+        } else {
+          break;
+        }
+      }
+      flush_run(r, c, end);
+      c = end;
+    }
+  }
+  stream_send();
+  profile_span_end(PROFILE_SPAN_LCD_FLUSH, stream_sent - sent, start);
+}
+
+// Groups several writes into a single flush (calls may be nested)
+void lcd_begin_frame() {
+  if (forward_op(DISPLAY_BEGIN_FRAME)) return;
+  frame_depth++;
 }
 
-void lcd_init(i2c_inst_t *i2c) {
-  i2c_instance = i2c;
+void lcd_end_frame() {
+  if (forward_op(DISPLAY_END_FRAME)) return;
+  if (frame_depth > 0 && --frame_depth == 0) {
+    lcd_flush();
+  }
+}
+
+// Writes a character at the cursor position
+void lcd_send_char(char c) {
+  if (forward(DISPLAY_CHAR, c, 0, 0, 0, NULL, NULL)) return;
+  frame[cursor_row][cursor_col] = (uint8_t)c;
+  advance_cursor();
+  if (frame_depth == 0) lcd_flush();
+}
 
+void lcd_init() {
+  if (forward_op(DISPLAY_INIT)) return;
+  backlight = LCD_BACKLIGHT;
   sleep_ms(50); // Waits for LCD initialization
   lcd_send_command(0x03);
   sleep_ms(5);
@@ -70,48 +220,80 @@ void lcd_init(i2c_inst_t *i2c) {
   sleep_ms(2);
   lcd_send_command(0x06); // Increments cursor
   lcd_send_command(0x0C); // Turns on display and cursor
+
+  memset(frame, ' ', sizeof(frame));
+  memset(glass, ' ', sizeof(glass));
+  glass_addr = 0;
+  progress_glyphs_loaded = false; // CGRAM does not survive a power cycle
+  cursor_row = 0;
+  cursor_col = 0;
+}
+
+// Display and backlight on or off; the controller keeps its contents while dark
+void lcd_set_power(bool on) {
+  if (forward(DISPLAY_POWER, on, 0, 0, 0, NULL, NULL)) return;
+  backlight = on ? LCD_BACKLIGHT : 0;
+  lcd_send_command(on ? 0x0C : 0x08);
 }
 
-// Clears the display
+// Clears the display (only the framebuffer when inside a frame)
 void lcd_clear() {
-  lcd_send_command(0x01); // Command to clear
-  sleep_ms(2);
+  if (forward_op(DISPLAY_CLEAR)) return;
+  lcd_animation_stop(LCD_ALL_ROWS, false); // Effects belong to the screen being cleared
+  memset(frame, ' ', sizeof(frame));
+  cursor_row = 0;
+  cursor_col = 0;
+  if (frame_depth == 0) lcd_flush();
 }
 
 // Initializes I2C communication for the LCD
 void init_i2c_lcd() {
-  i2c_init(I2C_PORT, 100 * 1000); // Configures I2C bus to 100 kHz
-  // Defines SDA and SCL pins
-  gpio_set_function(SDA_PIN, GPIO_FUNC_I2C);
-  gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
-  // Enables pull-up resistors for stable communication
-  gpio_pull_up(SDA_PIN);
-  gpio_pull_up(SCL_PIN);
-
-  lcd_init(I2C_PORT); // Initializes the LCD
+  i2c_bus_init();    // Shared bus with the RTC, configured once
+  lcd_init();        // Initializes the LCD
   lcd_clear();       // Clears the screen
 }
 
 // Sets the cursor position for text display
 void lcd_set_cursor(int row, int col) {
-  const uint8_t row_offsets[] = {0x00, 0x40, 0x14, 0x54};
-  lcd_send_command(0x80 | (col + row_offsets[row]));
+  if (forward(DISPLAY_SET_CURSOR, row, col, 0, 0, NULL, NULL)) return;
+  cursor_row = row;
+  cursor_col = col;
 }
 
 // Prints a string on the LCD
 void lcd_print(const char *str) {
+  if (forward(DISPLAY_PRINT, 0, 0, 0, 0, str, NULL)) return;
   while (*str) {
-    lcd_send_char(*str++);
+    frame[cursor_row][cursor_col] = (uint8_t)*str++;
+    advance_cursor();
+  }
+  if (frame_depth == 0) lcd_flush();
+}
+
+// Writes text at a position without moving the cursor; stops at the end of the row
+void lcd_print_at(int row, int col, const char *str) {
+  if (forward(DISPLAY_PRINT_AT, row, col, 0, 0, str, NULL)) return;
+  for (; *str && col < LCD_COLS; col++) {
+    frame[row][col] = (uint8_t)*str++;
   }
+  if (frame_depth == 0) lcd_flush();
 }
 
 // Creates a custom character
 void create_custom_char(int location, uint8_t charmap[]) {
+  if (display_task_forwarding()) {
+    display_command command = {DISPLAY_CUSTOM_CHAR, {location}, {0}};
+    memcpy(command.text, charmap, 8);
+    display_task_queue(&command);
+    return;
+  }
   location &= 0x7; // The LCD supports 8 characters (0-7)
-  lcd_send_command(0x40 | (location << 3));
+  stream_byte(0x40 | (location << 3), LCD_MODE_COMMAND);
   for (int i = 0; i < 8; i++) {
-    lcd_send_char(charmap[i]);
+    stream_byte(charmap[i], LCD_MODE_DATA);
   }
+  stream_send();
+  glass_addr = -1; // Next text write must select DDRAM again
 }
 
 // Displays a custom character at a specific position
@@ -121,52 +303,75 @@ void display_custom_char(int location, int row, int col) {
 }
 
 // **Animation Functions**
+/* Each function starts an effect on the timeline engine (lcd_animation.h) and
+   returns at once; the display task draws its steps. A new effect replaces the
+   one on its row, and lcd_clear() stops them all. */
+static void start_animation(lcd_animation_kind kind, int row, int col, int interval_ms, int hold_ms,
+                            int count, const char *text, const char *text2) {
+  lcd_animation animation = {.kind = kind, .row = row, .col = col, .interval_ms = interval_ms,
+                             .hold_ms = hold_ms, .count = count};
+  if (text != NULL) strncpy(animation.text, text, LCD_ANIMATION_TEXT_SIZE - 1);
+  if (text2 != NULL) strncpy(animation.text2, text2, LCD_COLS);
+  lcd_animation_start(&animation);
+}
 
-// Scroll text animation
-void scroll_text(const char *message, int row, int delay_ms) {
-  int len = strlen(message);
-  char buffer[LCD_COLS + 1] = {0};
-
-  for (int start = 0; start < len; start++) {
-    strncpy(buffer, message + start, LCD_COLS);
-    buffer[LCD_COLS] = '\0';
+// Stops the effect on a row (LCD_ALL_ROWS: on every row) where it is
+void lcd_cancel_animation(int row) {
+  if (forward(DISPLAY_STOP_ANIM, row, false, 0, 0, NULL, NULL)) return;
+  lcd_animation_stop(row, false);
+}
 
-    lcd_set_cursor(row, 0);
-    lcd_print(buffer);
-    sleep_ms(delay_ms);
+// Jumps the effect on a row (LCD_ALL_ROWS: on every row) to its end state
+void lcd_finish_animation(int row) {
+  if (forward(DISPLAY_STOP_ANIM, row, true, 0, 0, NULL, NULL)) return;
+  lcd_animation_stop(row, true);
+}
 
-    if (start + LCD_COLS >= len) {
-      start = -1; // Restart the cycle
-    }
-  }
+// Scroll text animation: loops over a text longer than the row until stopped
+void scroll_text(const char *message, int row, int delay_ms) {
+  if (forward(DISPLAY_SCROLL, row, delay_ms, 0, 0, message, NULL)) return;
+  start_animation(LCD_ANIMATION_SCROLL, row, 0, delay_ms, 0, 0, message, NULL);
 }
 // Example usage in `main`:
 // scroll_text("Welcome to Raspberry Pi Pico!", 0, 200);
 
 // Typing effect animation
 void type_effect(const char *message, int row, int delay_ms) {
-  lcd_set_cursor(row, 0);
-  for (int i = 0; i < strlen(message); i++) {
-    lcd_print((char[]) {
-      message[i], '\0'
-    }); // Sends one character at a time
-    sleep_ms(delay_ms);
-  }
+  if (forward(DISPLAY_TYPE, row, delay_ms, 0, 0, message, NULL)) return;
+  start_animation(LCD_ANIMATION_TYPE, row, 0, delay_ms, 0, 0, message, NULL);
 }
 // Example usage in `main`:
 // type_effect("Hello, World!", 0, 100);
 
-// Progress bar animation
+/* Progress bar with one step per pixel column: 20 cells of 5 columns give 100
+   steps. CGRAM codes 1-5 hold blocks 1 to 5 columns wide (code 0 would end a
+   string), loaded once. The bar is drawn into the framebuffer, so a step only
+   sends the one or two cells whose glyph changed. */
+#define PROGRESS_GLYPH_FIRST 1
+#define PROGRESS_CELL_COLUMNS 5
+
+static void load_progress_glyphs() {
+  for (int width = 1; width <= PROGRESS_CELL_COLUMNS; width++) {
+    uint8_t charmap[8];
+    memset(charmap, (0x1F << (PROGRESS_CELL_COLUMNS - width)) & 0x1F, sizeof(charmap));
+    create_custom_char(PROGRESS_GLYPH_FIRST + width - 1, charmap);
+  }
+  progress_glyphs_loaded = true;
+}
+
 void progress_bar(int percentage, int row) {
-  int filled = (percentage * LCD_COLS) / 100;
-  lcd_set_cursor(row, 0);
-  for (int i = 0; i < LCD_COLS; i++) {
-    if (i < filled) {
-      lcd_print("_");
-    } else {
-      lcd_print(" ");
-    }
+  if (forward(DISPLAY_PROGRESS, percentage, row, 0, 0, NULL, NULL)) return;
+  if (!progress_glyphs_loaded) load_progress_glyphs();
+  if (percentage < 0) percentage = 0;
+  if (percentage > 100) percentage = 100;
+
+  int columns = percentage * LCD_COLS * PROGRESS_CELL_COLUMNS / 100;
+  for (int c = 0; c < LCD_COLS; c++) {
+    int width = columns - c * PROGRESS_CELL_COLUMNS;
+    if (width > PROGRESS_CELL_COLUMNS) width = PROGRESS_CELL_COLUMNS;
+    frame[row][c] = width > 0 ? PROGRESS_GLYPH_FIRST + width - 1 : ' ';
   }
+  if (frame_depth == 0) lcd_flush();
 }
 // Example usage in `main`:
 // for (int i = 0; i <= 100; i += 10) {
@@ -174,54 +379,26 @@ void progress_bar(int percentage, int row) {
 //   sleep_ms(500);
 // }
 
-// Blinking text animation (alert)
+// Blinking text animation (alert), ends with the text shown
 void blink_text(const char *message, int row, int col, int times, int delay_ms) {
-  for (int i = 0; i < times; i++) {
-    lcd_set_cursor(row, col);
-    lcd_print(message);
-    sleep_ms(delay_ms);
-
-    lcd_set_cursor(row, col);
-    for (int j = 0; j < strlen(message); j++) {
-      lcd_print(" "); // Erases text
-    }
-    sleep_ms(delay_ms);
-  }
-
-  // Restores the text
-  lcd_set_cursor(row, col);
-  lcd_print(message);
+  if (forward(DISPLAY_BLINK, row, col, times, delay_ms, message, NULL)) return;
+  start_animation(LCD_ANIMATION_BLINK, row, col, delay_ms, 0, times, message, NULL);
 }
 // Example usage in `main`:
 // blink_text("ALERT!", 0, 5, 5, 500);
 
-// Fade text effect (erases and writes)
+// Fade text effect (erases and writes): message1 stays delay_ms before it is erased
 void fade_text(const char *message1, const char *message2, int row, int delay_ms) {
-  lcd_set_cursor(row, 0);
-  lcd_print(message1);
-  sleep_ms(delay_ms);
-
-  for (int i = strlen(message1); i >= 0; i--) {
-    lcd_set_cursor(row, i);
-    lcd_print(" ");
-    sleep_ms(50);
-  }
-
-  lcd_set_cursor(row, 0);
-  lcd_print(message2);
+  if (forward(DISPLAY_FADE, row, delay_ms, 0, 0, message1, message2)) return;
+  start_animation(LCD_ANIMATION_FADE, row, 0, 0, delay_ms, 0, message1, message2);
 }
 // Example usage in `main`:
 // fade_text("Welcome!", "Learning C!", 0, 1000);
 
 // Simple clock animation
 void simple_clock() {
-  for (int seconds = 0; seconds < 1000; seconds++) {
-    char time[20];
-    snprintf(time, sizeof(time), "Time: %03d sec", seconds);
-    lcd_set_cursor(0, 0);
-    lcd_print(time);
-    sleep_ms(1000);
-  }
+  if (forward_op(DISPLAY_CLOCK)) return;
+  start_animation(LCD_ANIMATION_CLOCK, 0, 0, 1000, 0, 1000, NULL, NULL);
 }
 // Example usage in `main`:
 // simple_clock();
\ No newline at end of file
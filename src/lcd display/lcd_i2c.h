@@ -2,32 +2,46 @@
 
 // This file provides LCD control functions, including:
 // - Basic text display
+// - A shadow framebuffer that only sends the cells that changed
+// - Streamed I2C writes (one transaction per flush) through the shared bus manager
 // - Custom characters
+// - Display and backlight power, for the low-power idle (power.h)
 // - Animations for better UI experience
+// - Forwarding to the core 1 display task once it runs (see display_task.h)
 
 #ifndef LCD_I2C_H
 #define LCD_I2C_H
 
-#include "hardware/i2c.h"
+#include <stdint.h>
+#include <stdbool.h>
 
 #define LCD_ADDR 0x27
 #define LCD_ROWS 4
 #define LCD_COLS 20
+#define LCD_ALL_ROWS -1
 
-void lcd_init(i2c_inst_t *i2c);
+void lcd_init();
 void lcd_clear();
 void init_i2c_lcd();
 void lcd_set_cursor(int row, int col);
 void lcd_print(const char *str);
+void lcd_print_at(int row, int col, const char *str); // Leaves the cursor alone; clipped to the row
 void lcd_send_char(char c);
+void lcd_flush();       // Sends the cells that changed since the last flush
+void lcd_begin_frame(); // Holds back flushing so a whole screen is sent at once
+void lcd_end_frame();   // Flushes the screen composed since lcd_begin_frame()
+void lcd_set_power(bool on); // Display and backlight together; the text survives
 void create_custom_char(int location, uint8_t charmap[]);
 void display_custom_char(int location, int row, int col);
 
+// Animations run in the background on the display task and return at once; one per row
 void scroll_text(const char *message, int row, int delay_ms);
 void type_effect(const char *message, int row, int delay_ms);
-void progress_bar(int percentage, int row);
+void progress_bar(int percentage, int row); // 0-100, one step per pixel column; redraws only changed cells
 void blink_text(const char *message, int row, int col, int times, int delay_ms);
 void fade_text(const char *message1, const char *message2, int row, int delay_ms);
 void simple_clock();
+void lcd_cancel_animation(int row); // Stops it where it is (LCD_ALL_ROWS: every row)
+void lcd_finish_animation(int row); // Jumps to its end state (LCD_ALL_ROWS: every row)
 
 #endif // LCD_I2C_H
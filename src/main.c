@@ -24,16 +24,29 @@ https://github.com/daniamorimdesa/CoffeeTime-SmartCoffeeMachine
 #include "user_interface.h"
 #include "internal_operations.h"
 #include "state.h"
+#include "event_loop.h"
+#include "profile.h"
+#include "power.h"
 
 #define IR_SENSOR_GPIO_PIN 1 // Remote IR control for sending commands to the machine
 
+extern State current_state;
+
 int main() {
   setup_machine();
-  init_ir_irq_receiver(IR_SENSOR_GPIO_PIN, &ir_callback);
+  init_ir_irq_receiver(IR_SENSOR_GPIO_PIN);
+  power_init(IR_SENSOR_GPIO_PIN); // The initial screen goes dark after a minute untouched
 
+  uint32_t events = EVENT_STATE_CHANGE; // Runs the initial state right away
   while (true) {
-    manage_state();  // Delegating control to the current state
-    sleep_ms(200);
+    key_event key;
+    while (key_event_pop(&key)) handle_key(&key); // Keys are handled here, outside the interrupt
+    State state = current_state;
+    uint32_t tick_start = profile_now();
+    manage_state(events);  // Delegating control to the current state
+    profile_span_end(PROFILE_SPAN_STATE_TICK, state, tick_start);
+    // Sleeps until a key, a deadline or a state change (deeper while the screen is dark)
+    events = power_is_idle() ? power_idle_wait() : event_wait();
   }
   return 0;
 }
\ No newline at end of file
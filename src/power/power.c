@@ -0,0 +1,164 @@
+// power.c
+
+#include "power.h"
+#include "event_loop.h"
+#include "lcd_i2c.h"
+#include "display_task.h"
+#include "sensors.h"
+#include "time_service.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/xosc.h"
+#include "hardware/clocks.h"
+#include "pico/sleep.h"
+
+static struct {
+  uint ir_gpio;
+  bool idle;
+  volatile uint32_t sqw_edges; // Counted by the interrupt
+  uint32_t sqw_seen;           // Edges already applied to the clock
+  bool drop_key;               // The next press woke the screen
+  uint32_t drop_until_us;
+  power_stats stats;
+} power;
+
+// ---------------------------------- Wake Sources ---------------------------------- //
+#if RTC_SQW_PIN >= 0
+static void sqw_irq(void) {
+  if (gpio_get_irq_event_mask(RTC_SQW_PIN) & GPIO_IRQ_EDGE_FALL) {
+    gpio_acknowledge_irq(RTC_SQW_PIN, GPIO_IRQ_EDGE_FALL);
+    power.sqw_edges++;
+  }
+}
+#endif
+
+static void set_dormant_wake(bool enabled) {
+  gpio_set_dormant_irq_enabled(power.ir_gpio, GPIO_IRQ_EDGE_FALL, enabled);
+#if RTC_SQW_PIN >= 0
+  gpio_set_dormant_irq_enabled(RTC_SQW_PIN, GPIO_IRQ_EDGE_FALL, enabled);
+#endif
+}
+
+// Stopping the crystal also stops the timer, so a pending brew needs the square wave to keep time
+static bool can_go_dormant() {
+  return RTC_SQW_PIN >= 0 || scheduler_count() == 0;
+}
+
+// Each edge is one RTC second (see time_service.h)
+static void apply_sqw_edges() {
+  while (power.sqw_seen != power.sqw_edges) {
+    power.sqw_seen++;
+    power.stats.sqw_edges++;
+    time_service_sqw_edge();
+  }
+}
+
+static bool brew_due() {
+  brew_job job;
+  return scheduler_peek(&job) && time_us_until_epoch_minute(job.due) <= 0;
+}
+
+// ---------------------------------- Idle ---------------------------------- //
+void power_init(uint ir_gpio) {
+  power.ir_gpio = ir_gpio;
+#if RTC_SQW_PIN >= 0
+  gpio_init(RTC_SQW_PIN);
+  gpio_pull_up(RTC_SQW_PIN); // SQW/OUT is open drain
+  gpio_add_raw_irq_handler(RTC_SQW_PIN, sqw_irq);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+  rtc_set_square_wave(true);
+#endif
+  power_activity();
+}
+
+void power_activity() {
+  event_schedule(EVENT_IDLE_TIMEOUT, make_timeout_time_ms(POWER_IDLE_TIMEOUT_MS));
+}
+
+bool power_is_idle() {
+  return power.idle;
+}
+
+// The screen goes dark before the clocks slow down, so core 1 does not draw at crystal speed
+void power_enter_idle() {
+  if (power.idle) return;
+  lcd_finish_animation(LCD_ALL_ROWS);
+  lcd_set_power(false);
+  display_task_sync();
+  sensors_pause();
+  event_cancel(EVENT_CLOCK_MINUTE | EVENT_SENSOR_REFRESH | EVENT_IDLE_TIMEOUT);
+
+  sleep_run_from_xosc();
+  i2c_bus_clock_changed();
+#if RTC_SQW_PIN >= 0
+  time_service_sqw_start();
+  power.sqw_seen = power.sqw_edges;
+  gpio_set_irq_enabled(RTC_SQW_PIN, GPIO_IRQ_EDGE_FALL, true);
+#endif
+  power.idle = true;
+  power.stats.entries++;
+}
+
+// Back to full speed; the clock and the scheduler alarm are corrected for the time the timer was stopped
+static uint32_t wake(uint32_t events, bool by_key) {
+  uint32_t start = time_us_32();
+  sleep_power_up();
+  clocks_init();
+  i2c_bus_clock_changed();
+#if RTC_SQW_PIN >= 0
+  gpio_set_irq_enabled(RTC_SQW_PIN, GPIO_IRQ_EDGE_FALL, false);
+#else
+  time_service_resync();
+#endif
+  scheduler_resync();
+  sensors_resume();
+  lcd_set_power(true);
+  display_task_sync();
+
+  power.idle = false;
+  power.drop_key = by_key;
+  power.drop_until_us = time_us_32() + POWER_WAKE_FRAME_US;
+  power_activity();
+  event_schedule(EVENT_SENSOR_REFRESH, make_timeout_time_ms(POWER_SENSOR_SETTLE_MS));
+
+  uint32_t latency = time_us_32() - start;
+  power.stats.wakes++;
+  power.stats.wake_latency_us = latency;
+  if (latency > power.stats.max_wake_latency_us) power.stats.max_wake_latency_us = latency;
+  return events | EVENT_CLOCK_MINUTE; // Redraws the clock, which moved on while dark
+}
+
+uint32_t power_idle_wait() {
+  while (true) {
+    uint32_t events = EVENT_NONE;
+    bool by_key;
+    if (can_go_dormant()) {
+      uint32_t edges = power.sqw_edges;
+      set_dormant_wake(true);
+      power.stats.dormant_entries++;
+      xosc_dormant(); // Returns once the crystal runs again
+      set_dormant_wake(false);
+      by_key = power.sqw_edges == edges; // Not the square wave: the IR receiver
+    } else {
+      events = event_wait(); // A key or the scheduler alarm
+      by_key = (events & EVENT_INPUT) != 0;
+    }
+
+    apply_sqw_edges();
+    if (brew_due()) events |= EVENT_SCHEDULE;
+    if (by_key || events != EVENT_NONE) return wake(events, by_key);
+  }
+}
+
+// The frame that woke the chip is still decoded; its key is dropped rather than acted on
+bool power_wake_key(const key_event *event) {
+  if (!power.drop_key) return false;
+  power.drop_key = false;
+  return (int32_t)(event->timestamp_us - power.drop_until_us) < 0;
+}
+
+power_stats power_get_stats() {
+  return power.stats;
+}
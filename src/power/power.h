@@ -0,0 +1,50 @@
+// power.h
+
+// Low-power idle for the initial screen:
+// - After POWER_IDLE_TIMEOUT_MS without a key the LCD goes dark (display and backlight off),
+//   DHT22/ADC sampling stops and clk_sys drops from the PLLs to the 12 MHz crystal
+// - The main loop then waits in power_idle_wait(): dormant (crystal stopped) when nothing needs
+//   the timer, otherwise WFE at crystal speed so the scheduler alarm can still fire
+// - A falling edge from the IR receiver, or from the DS1307 1 Hz square wave when it is wired,
+//   wakes the chip. A key press only wakes the screen; a due scheduled brew wakes it and starts
+//
+// Usage in the main loop:
+//   events = power_is_idle() ? power_idle_wait() : event_wait();
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "ir_control.h"
+
+#define POWER_IDLE_TIMEOUT_MS (60 * 1000) // Untouched initial screen before it goes dark
+#define POWER_WAKE_FRAME_US   120000      // The NEC frame that woke the screen ends within this
+#define POWER_SENSOR_SETTLE_MS 20         // First DHT22 reading after a wake
+
+// GPIO wired to the DS1307 SQW/OUT pin. Every exposed pin of this board is taken (GP0 carries
+// the UART console), so it is off by default: the chip then only goes dormant while no brew is
+// scheduled and reads the RTC on wake. With it, dormant sleep wakes once a second to count time.
+#ifndef RTC_SQW_PIN
+#define RTC_SQW_PIN -1
+#endif
+
+typedef struct {
+  uint32_t entries;             // Times the screen went dark
+  uint32_t dormant_entries;     // Times the crystal was stopped
+  uint32_t sqw_edges;           // Square-wave edges counted while idle
+  uint32_t wakes;
+  uint32_t wake_latency_us;     // Last wake: from the chip running again to the screen lit
+  uint32_t max_wake_latency_us;
+} power_stats;
+
+void power_init(uint ir_gpio);       // After the IR receiver; arms the first idle timeout
+void power_activity();               // Restarts the idle countdown
+void power_enter_idle();             // Dark screen, sampling stopped, clocks from the crystal
+bool power_is_idle();
+uint32_t power_idle_wait();          // Sleeps until a wake source; returns the events to handle
+bool power_wake_key(const key_event *event); // True for the press that woke the screen (drop it)
+power_stats power_get_stats();
+
+#endif // POWER_H
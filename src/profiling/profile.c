@@ -0,0 +1,142 @@
+// profile.c
+
+#include "profile.h"
+
+#if PROFILING_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+#define PROFILE_LINE_BYTES 32 // Blob bytes per "#P" line
+
+// One ring per core, so the cores never write the same memory; interrupts are masked
+// around a write so an alarm cannot interleave with thread code on the same core
+static struct {
+  profile_record records[PROFILE_RING_SIZE];
+  volatile uint32_t written; // Records ever written; the newest is at written - 1
+} rings[PROFILE_CORES];
+
+static volatile uint32_t counters[PROFILE_COUNTER_COUNT];
+static uint64_t counters_since_us = 0;
+
+void profile_span_end(profile_span span, uint16_t arg, uint32_t start_us) {
+  uint32_t end_us = time_us_32();
+  uint core = get_core_num();
+
+  uint32_t irq = save_and_disable_interrupts();
+  profile_record *r = &rings[core].records[rings[core].written & (PROFILE_RING_SIZE - 1)];
+  r->start_us = start_us;
+  r->duration_us = end_us - start_us;
+  r->span = span;
+  r->core = core;
+  r->arg = arg;
+  rings[core].written++;
+  restore_interrupts(irq);
+}
+
+void profile_count(profile_counter counter, uint32_t n) {
+  counters[counter] += n;
+}
+
+void profile_reset(void) {
+  for (int core = 0; core < PROFILE_CORES; core++) {
+    rings[core].written = 0;
+  }
+  for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+    counters[i] = 0;
+  }
+  counters_since_us = time_us_64();
+}
+
+uint32_t profile_read(int core, profile_record *out, uint32_t max) {
+  if (core < 0 || core >= PROFILE_CORES) return 0;
+  uint32_t written = rings[core].written;
+  uint32_t kept = written < PROFILE_RING_SIZE ? written : PROFILE_RING_SIZE;
+  if (kept > max) kept = max;
+  for (uint32_t i = 0; i < kept; i++) {
+    out[i] = rings[core].records[(written - kept + i) & (PROFILE_RING_SIZE - 1)];
+  }
+  return kept;
+}
+
+// ---------------------------------- Dump ---------------------------------- //
+static struct {
+  uint8_t line[PROFILE_LINE_BYTES];
+  int fill;
+  uint16_t sum;
+} out;
+
+static void emit_line() {
+  static const char hex[] = "0123456789abcdef";
+  char text[PROFILE_LINE_BYTES * 2 + 1];
+  for (int i = 0; i < out.fill; i++) {
+    text[i * 2] = hex[out.line[i] >> 4];
+    text[i * 2 + 1] = hex[out.line[i] & 0xF];
+  }
+  text[out.fill * 2] = '\0';
+  printf("#P %s\n", text);
+  out.fill = 0;
+}
+
+static void emit(uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    uint8_t b = (uint8_t)(value >> (8 * i));
+    out.sum += b;
+    out.line[out.fill++] = b;
+    if (out.fill == PROFILE_LINE_BYTES) emit_line();
+  }
+}
+
+// The other core may add a record while its ring is copied out; that one record can come out torn
+void profile_dump(void) {
+  uint32_t written[PROFILE_CORES];
+  uint32_t records = 0;
+  uint32_t dropped = 0;
+  for (int core = 0; core < PROFILE_CORES; core++) {
+    written[core] = rings[core].written;
+    uint32_t kept = written[core] < PROFILE_RING_SIZE ? written[core] : PROFILE_RING_SIZE;
+    records += kept;
+    dropped += written[core] - kept;
+  }
+
+  uint32_t bytes = PROFILE_HEADER_BYTES + PROFILE_COUNTER_COUNT * 4 + records * PROFILE_RECORD_BYTES;
+  printf("#PROFILE BEGIN %u\n", (unsigned)bytes);
+  out.fill = 0;
+  out.sum = 0;
+
+  emit('P', 1);
+  emit('R', 1);
+  emit('O', 1);
+  emit('F', 1);
+  emit(PROFILE_FORMAT_VERSION, 1);
+  emit(PROFILE_SPAN_COUNT, 1);
+  emit(PROFILE_COUNTER_COUNT, 1);
+  emit(PROFILE_CORES, 1);
+  emit(time_us_64(), 8);
+  emit(counters_since_us, 8);
+  emit(dropped, 4);
+  emit(records, 2);
+  emit(PROFILE_RING_SIZE, 2);
+
+  for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+    emit(counters[i], 4);
+  }
+
+  // Oldest first within each core
+  for (int core = 0; core < PROFILE_CORES; core++) {
+    uint32_t first = written[core] > PROFILE_RING_SIZE ? written[core] - PROFILE_RING_SIZE : 0;
+    for (uint32_t n = first; n < written[core]; n++) {
+      const profile_record *r = &rings[core].records[n & (PROFILE_RING_SIZE - 1)];
+      emit(r->start_us, 4);
+      emit(r->duration_us, 4);
+      emit(r->span, 1);
+      emit(r->core, 1);
+      emit(r->arg, 2);
+    }
+  }
+  if (out.fill > 0) emit_line();
+  printf("#PROFILE END %04x\n", out.sum);
+}
+
+#endif // PROFILING_ENABLED
@@ -0,0 +1,94 @@
+// profile.h
+
+// Lightweight instrumentation for live machines:
+// - Spans: start time and duration (time_us_32) of a call site, kept in a fixed ring per core;
+//   once a ring is full the oldest records are overwritten (and counted as dropped)
+// - Counters: running totals for the bus and the interrupt-driven actuators
+// - profile_dump(): rings and counters as one binary blob over stdio, hex-armoured because USB
+//   stdio rewrites line endings; host/tools/profile_decode.c turns a capture into a report
+//
+// Usage:
+//   uint32_t start = profile_now();
+//   ...
+//   profile_span_end(PROFILE_SPAN_RTC_READ, ok, start);
+//
+// Build with PROFILING_ENABLED=0 to compile every call out.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#ifndef PROFILING_ENABLED
+#define PROFILING_ENABLED 1
+#endif
+
+#define PROFILE_RING_SIZE 256 // Records per core (power of two)
+#define PROFILE_CORES 2
+
+// Dump layout, little-endian:
+//   header  "PROF", version, span count, counter count, core count (4 x u8),
+//           now_us (u64), counters_since_us (u64), dropped (u32), records (u16), ring size (u16)
+//   counters (u32 each), then records of PROFILE_RECORD_BYTES:
+//           start_us (u32, low bits of time_us_64), duration_us (u32), span (u8), core (u8), arg (u16)
+// Text framing: "#PROFILE BEGIN <bytes>", lines of "#P <hex>", "#PROFILE END <sum of bytes & 0xFFFF>"
+#define PROFILE_FORMAT_VERSION 1
+#define PROFILE_HEADER_BYTES 32
+#define PROFILE_RECORD_BYTES 12
+
+typedef enum {
+  PROFILE_SPAN_STATE_TICK,  // One manage_state() call; arg: state
+  PROFILE_SPAN_BREW_STAGE,  // A brew stage from start() to complete(); arg: stage
+  PROFILE_SPAN_BREW,        // A whole preparation; arg: cups
+  PROFILE_SPAN_RTC_READ,    // rtc_read(); arg: 1 when the RTC answered
+  PROFILE_SPAN_DHT_DECODE,  // Decode of a background DHT22 sample; arg: 1 for a good frame
+  PROFILE_SPAN_LCD_FLUSH,   // lcd_flush() that sent something; arg: expander bytes
+  PROFILE_SPAN_COUNT
+} profile_span;
+
+typedef enum {
+  PROFILE_COUNT_I2C_BYTES,        // Bytes on the wire, address bytes included
+  PROFILE_COUNT_I2C_TRANSACTIONS,
+  PROFILE_COUNT_I2C_ERRORS,
+  PROFILE_COUNT_IR_IRQS,          // IR receiver edge interrupts
+  PROFILE_COUNT_STEPPER_STEPS,    // Step pulses from the stepper alarm
+  PROFILE_COUNT_SERVO_FRAMES,     // Motion engine ticks
+  PROFILE_COUNTER_COUNT
+} profile_counter;
+
+// Same order as the enums, for reports
+#define PROFILE_SPAN_NAMES {"state tick", "brew stage", "brew", "rtc read", "dht decode", "lcd flush"}
+#define PROFILE_COUNTER_NAMES {"i2c bytes", "i2c transactions", "i2c errors", "ir irqs", \
+                               "stepper steps", "servo frames"}
+
+typedef struct {
+  uint32_t start_us;
+  uint32_t duration_us;
+  uint8_t span;
+  uint8_t core;
+  uint16_t arg;
+} profile_record;
+
+#if PROFILING_ENABLED
+static inline uint32_t profile_now(void) {
+  return time_us_32();
+}
+
+void profile_span_end(profile_span span, uint16_t arg, uint32_t start_us); // Safe from interrupts and either core
+// Each counter must have one writer at a time (its interrupt, or code under the bus lock)
+void profile_count(profile_counter counter, uint32_t n);
+void profile_dump(void);  // Writes the blob to stdout
+void profile_reset(void); // Empties the rings and zeroes the counters
+uint32_t profile_read(int core, profile_record *out, uint32_t max); // Newest records of a core, oldest first
+#else
+static inline uint32_t profile_now(void) { return 0; }
+static inline void profile_span_end(profile_span span, uint16_t arg, uint32_t start_us) {}
+static inline void profile_count(profile_counter counter, uint32_t n) {}
+static inline void profile_dump(void) {}
+static inline void profile_reset(void) {}
+static inline uint32_t profile_read(int core, profile_record *out, uint32_t max) { return 0; }
+#endif
+
+#endif // PROFILE_H
@@ -0,0 +1,157 @@
+// scheduler.c
+// Brew scheduler: min-heap of pending jobs and one alarm for the earliest
+
+#include "scheduler.h"
+#include "time_service.h"
+#include "event_loop.h"
+#include "pico/stdlib.h"
+
+static brew_job heap[SCHEDULER_MAX_JOBS];
+static uint8_t count = 0;
+static alarm_id_t armed_alarm = 0;
+
+// ---------------------------------- Heap ---------------------------------- //
+static void swap(uint8_t a, uint8_t b) {
+  brew_job tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+}
+
+static void sift_up(uint8_t i) {
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (heap[parent].due <= heap[i].due) break;
+    swap(parent, i);
+    i = parent;
+  }
+}
+
+static void sift_down(uint8_t i) {
+  while (true) {
+    uint8_t smallest = i;
+    uint8_t left = 2 * i + 1;
+    uint8_t right = left + 1;
+    if (left < count && heap[left].due < heap[smallest].due) smallest = left;
+    if (right < count && heap[right].due < heap[smallest].due) smallest = right;
+    if (smallest == i) break;
+    swap(i, smallest);
+    i = smallest;
+  }
+}
+
+static bool push(brew_job job) {
+  if (count >= SCHEDULER_MAX_JOBS) return false;
+  heap[count] = job;
+  sift_up(count++);
+  return true;
+}
+
+static brew_job pop() {
+  brew_job top = heap[0];
+  heap[0] = heap[--count];
+  sift_down(0);
+  return top;
+}
+
+// ---------------------------------- Alarm ---------------------------------- //
+static int64_t scheduler_alarm(alarm_id_t id, void *user_data) {
+  armed_alarm = 0;
+  event_post(EVENT_SCHEDULE);
+  return 0;
+}
+
+// Points the one alarm at the earliest job (or fires right away if it is overdue)
+static void arm() {
+  if (armed_alarm > 0) cancel_alarm(armed_alarm);
+  armed_alarm = 0;
+  if (count == 0) return;
+
+  int64_t delay = time_us_until_epoch_minute(heap[0].due);
+  alarm_id_t id = add_alarm_in_us(delay > 0 ? (uint64_t)delay : 0, scheduler_alarm, NULL, true);
+  armed_alarm = id > 0 ? id : 0; // Pool full (-1): left unarmed so the next scheduler_pop_due() retries
+}
+
+// First minute after `after` that falls on one of the weekdays at the given time of day
+static uint32_t next_occurrence(uint8_t weekdays, uint16_t minute_of_day, uint32_t after) {
+  DateTime dt;
+  uint32_t day = after / 1440;
+  for (uint8_t d = 0; d <= 7; d++) {
+    uint32_t candidate = (day + d) * 1440 + minute_of_day;
+    datetime_from_epoch_minutes(candidate, &dt);
+    if (candidate > after && (weekdays & (1u << dt.weekday))) return candidate;
+  }
+  return after + 1440; // Unreachable for a non-empty mask
+}
+
+// ---------------------------------- Public API ---------------------------------- //
+bool scheduler_add(uint32_t due, uint8_t cups) {
+  if (!push((brew_job) {due, cups, SCHEDULE_ONCE})) return false;
+  arm();
+  return true;
+}
+
+bool scheduler_add_recurring(uint8_t weekdays, uint8_t hour, uint8_t minute, uint8_t cups) {
+  weekdays &= SCHEDULE_DAILY;
+  if (weekdays == 0) return false;
+  uint32_t due = next_occurrence(weekdays, hour * 60 + minute, time_epoch_minutes());
+  if (!push((brew_job) {due, cups, weekdays})) return false;
+  arm();
+  return true;
+}
+
+// Called from thread context on every wake-up outside a brew
+// A recurring job that was missed runs once and moves on to its next future slot
+bool scheduler_pop_due(brew_job *job) {
+  if (count == 0) return false;
+  uint32_t now = time_epoch_minutes();
+  if (now == 0 || heap[0].due > now) {
+    if (armed_alarm == 0) arm(); // Woken early, e.g. after a clock correction
+    return false;
+  }
+
+  *job = pop();
+  if (job->weekdays != SCHEDULE_ONCE) {
+    brew_job next = *job;
+    next.due = next_occurrence(job->weekdays, job->due % 1440, now);
+    push(next);
+  }
+  arm();
+  return true;
+}
+
+bool scheduler_peek(brew_job *job) {
+  if (count == 0) return false;
+  *job = heap[0];
+  return true;
+}
+
+uint8_t scheduler_count() {
+  return count;
+}
+
+void scheduler_clear() {
+  count = 0;
+  arm();
+}
+
+void scheduler_resync() {
+  arm();
+}
+
+uint8_t scheduler_list(brew_job *jobs, uint8_t max) {
+  uint8_t n = count < max ? count : max;
+  for (uint8_t i = 0; i < n; i++) jobs[i] = heap[i];
+  return n;
+}
+
+// A one-shot job missed while the power was off is dropped; a recurring one moves to its next slot
+bool scheduler_restore(brew_job job) {
+  uint32_t now = time_epoch_minutes();
+  if (now != 0 && job.due <= now) {
+    if (job.weekdays == SCHEDULE_ONCE) return true;
+    job.due = next_occurrence(job.weekdays & SCHEDULE_DAILY, job.due % 1440, now);
+  }
+  if (!push(job)) return false;
+  arm();
+  return true;
+}
@@ -0,0 +1,36 @@
+// scheduler.h
+// Pending brews kept in a min-heap ordered by their due time (epoch minutes,
+// see time_service.h). A single timer alarm is armed for the earliest job and
+// posts EVENT_SCHEDULE; jobs that are already overdue are handed out at once.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHEDULER_MAX_JOBS 8
+
+// Recurrence masks: bit 0 = Sunday ... bit 6 = Saturday
+#define SCHEDULE_ONCE     0x00
+#define SCHEDULE_WEEKDAYS 0x3E
+#define SCHEDULE_DAILY    0x7F
+
+// One pending brew
+typedef struct {
+  uint32_t due;      // Epoch minutes of the next run
+  uint8_t cups;
+  uint8_t weekdays;  // SCHEDULE_ONCE, or the days a recurring job runs on
+} brew_job;
+
+bool scheduler_add(uint32_t due, uint8_t cups);   // One-shot job; false when the queue is full
+bool scheduler_add_recurring(uint8_t weekdays, uint8_t hour, uint8_t minute, uint8_t cups);
+bool scheduler_pop_due(brew_job *job);            // Takes the earliest overdue job, re-arms for the next
+bool scheduler_peek(brew_job *job);               // Earliest job without removing it
+uint8_t scheduler_count();
+void scheduler_clear();
+void scheduler_resync();                          // Re-aims the alarm after the timer or the wall clock jumped
+uint8_t scheduler_list(brew_job *jobs, uint8_t max); // Copies the pending jobs (in no particular order)
+bool scheduler_restore(brew_job job);             // Re-adds a saved job; false when the queue is full
+
+#endif // SCHEDULER_H
@@ -6,162 +6,331 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
-#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "i2c_bus.h"
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include "lcd_i2c.h"
+#include "lcd_format.h"
 #include "ir_control.h"
 #include "pico/time.h"
 #include "actuators.h"
+#include "time_service.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "profile.h"
 
 #define RED_LED 12    // Red LED: indicates that the machine needs refilling
 #define BUZZER_PIN 14 // Buzzer: used for sound notifications
 
-extern float water_ml;
-extern float coffee_beans_g;
-extern bool play_pressed;
-const uint MAX_TIMINGS = 85;
+extern int water_ml;
+extern int coffee_beans_g;
 
 typedef enum {
   STATE_CONFIG_DAY,
+  STATE_DAY_CONFIRMED,
   STATE_CONFIG_HOUR,
+  STATE_CONFIG_HOUR_UNITS,
+  STATE_HOUR_CONFIRMED,
   STATE_CONFIG_MINUTES,
+  STATE_CONFIG_MINUTES_UNITS,
+  STATE_MINUTES_CONFIRMED,
   STATE_VALIDATION,
   STATE_COMPLETED,
+  STATE_SCHEDULE_FULL,
   STATE_INVALID,
+  STATE_FINISHED,
 } TimeConfigState;
 
 // ---------------------------------- ADC (Potentiometers) ---------------------------------- //
-// Initializes the ADC and configures the potentiometer pins
+// The ADC converts inputs 0..2 round-robin in free-running mode. Two chained DMA
+// channels ping-pong between two blocks of ADC_OVERSAMPLE samples per input; when
+// a block is full its interrupt averages it per input (decimation) and re-arms
+// the channel while the other one keeps sampling. Readers only load the latest average.
+#define ADC_INPUTS         3
+#define ADC_OVERSAMPLE     16                              // Samples averaged per input
+#define ADC_BLOCK          (ADC_INPUTS * ADC_OVERSAMPLE)  // Keeps each block aligned to input 0
+#define ADC_SAMPLE_RATE_HZ 3000                            // All inputs together: 1 kHz each, a new average every 16 ms
+
+static uint16_t adc_blocks[2][ADC_BLOCK];
+static int adc_dma[2];
+static volatile uint16_t adc_average[ADC_INPUTS];
+
+static void adc_dma_irq(void) {
+  for (int i = 0; i < 2; i++) {
+    if (!dma_channel_get_irq0_status(adc_dma[i])) continue;
+    dma_channel_acknowledge_irq0(adc_dma[i]);
+
+    uint32_t sums[ADC_INPUTS] = {0};
+    const uint16_t *sample = adc_blocks[i];
+    for (int n = 0; n < ADC_OVERSAMPLE; n++) {
+      for (int input = 0; input < ADC_INPUTS; input++) {
+        sums[input] += *sample++ & 0x0FFF;
+      }
+    }
+    for (int input = 0; input < ADC_INPUTS; input++) {
+      adc_average[input] = (sums[input] + ADC_OVERSAMPLE / 2) / ADC_OVERSAMPLE;
+    }
+
+    // Ready for its next turn once the other channel finishes
+    dma_channel_set_write_addr(adc_dma[i], adc_blocks[i], false);
+  }
+}
+
+// Initializes the ADC and configures the potentiometer pins, then starts background sampling
 void init_adc() {
   adc_init();
   adc_gpio_init(26); // INTENSITY_POT_PIN
   adc_gpio_init(27); // TEMP_WATER_PIN
   adc_gpio_init(28); // WATER_AMOUNT_PIN
+
+  // One conversion per input so the averages are valid before the first block completes
+  for (int input = 0; input < ADC_INPUTS; input++) {
+    adc_select_input(input);
+    adc_average[input] = adc_read();
+  }
+
+  adc_select_input(0);
+  adc_set_round_robin((1u << ADC_INPUTS) - 1);
+  adc_fifo_setup(true, true, 1, false, false); // DREQ on every sample
+  adc_set_clkdiv(48000000.0f / ADC_SAMPLE_RATE_HZ - 1);
+
+  adc_dma[0] = dma_claim_unused_channel(true);
+  adc_dma[1] = dma_claim_unused_channel(true);
+  for (int i = 0; i < 2; i++) {
+    dma_channel_config config = dma_channel_get_default_config(adc_dma[i]);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_dreq(&config, DREQ_ADC);
+    channel_config_set_chain_to(&config, adc_dma[1 - i]);
+    dma_channel_configure(adc_dma[i], &config, adc_blocks[i], &adc_hw->fifo, ADC_BLOCK, i == 0);
+    dma_channel_set_irq0_enabled(adc_dma[i], true);
+  }
+  irq_set_exclusive_handler(DMA_IRQ_0, adc_dma_irq);
+  irq_set_enabled(DMA_IRQ_0, true);
+  adc_run(true);
+}
+
+// Latest oversampled value of an input (12-bit); constant time, never blocks
+uint16_t adc_get_average(uint input) {
+  return adc_average[input];
 }
 
 // Reads the intensity potentiometer (0 to 100%)
 int read_intensity() {
-  adc_select_input(0); // ADC0 (GPIO26)
-  sleep_us(500);       // Waits for stabilization
-  adc_read();          // Discards the first reading
-  uint16_t raw_value = adc_read();
+  uint16_t raw_value = adc_get_average(0); // ADC0 (GPIO26)
   return (raw_value * 100) / 4095; // Converts to percentage
 }
 
-// Reads the temperature potentiometer (85°C to 95°C)
-float read_desired_temperature() {
-  adc_select_input(1); // ADC1 (GPIO27)
-  sleep_us(500);
-  adc_read();          // Discards the first reading
-  uint16_t raw_value = adc_read();
+// Maps to 85.0°C - 95.0°C in tenths; truncating keeps the same level thresholds as the real-valued map
+int16_t desired_temperature_from_adc(uint16_t raw) {
+  return 850 + (int16_t)(((uint32_t)raw * 100) / 4095);
+}
 
-  float percentage = (raw_value * 100.0) / 4095.0;
-  return 85.0 + ((percentage * 10.0) / 100.0); // Maps to 85°C - 95°C
+// Reads the temperature potentiometer (0.1 °C units, 850 to 950)
+int16_t read_desired_temperature() {
+  return desired_temperature_from_adc(adc_get_average(1)); // ADC1 (GPIO27)
 }
 
 // Reads the water quantity potentiometer (50 ml to 200 ml)
 int read_water_quantity() {
-  adc_select_input(2); // ADC2 (GPIO28)
-  sleep_us(500);
-  adc_read();          // Discards the first reading
-  uint16_t raw_value = adc_read();
+  uint16_t raw_value = adc_get_average(2); // ADC2 (GPIO28)
   return 50 + ((raw_value * 150) / 4095); // Maps to 50 ml - 200 ml
 }
 
 // ---------------------------------- DHT22 (Temperature and Humidity) ---------------------------------- //
-void read_from_dht(dht_reading *result, const uint DHT_PIN) {
-  int data[5] = {0, 0, 0, 0, 0};
-  uint last = 1;
-  uint j = 0;
-
-  // Initialization
-  gpio_set_dir(DHT_PIN, GPIO_OUT);
-  gpio_put(DHT_PIN, 0);
-  sleep_ms(20);
-  gpio_set_dir(DHT_PIN, GPIO_IN);
-
-  // Sensor reading
-  for (uint i = 0; i < MAX_TIMINGS; i++) {
-    uint count = 0;
-    while (gpio_get(DHT_PIN) == last) {
-      count++;
-      sleep_us(1);
-      if (count == 255) break;
-    }
-    last = gpio_get(DHT_PIN);
-    if (count == 255) break;
+// The sensor is sampled in the background by one repeating alarm:
+// start pulse (line held low) -> release and capture falling edges -> decode.
+// Edges are timestamped by a raw GPIO interrupt, so nobody busy-waits on the wire
+// and readers only ever copy the cached result.
+#define DHT_START_US   2000                      // Host start pulse (datasheet: at least 1 ms)
+#define DHT_CAPTURE_US 8000                      // Whole response is ~5 ms
+#define DHT_EDGES      42                        // Response edge, 40 bit edges, end-of-frame edge
+#define DHT_ONE_US     100                       // Falling-to-falling gap: ~76 us for a 0, ~120 us for a 1
+#define DHT_STALE_US   (3 * DHT_PERIOD_MS * 1000) // Cache goes invalid after three missed samples
 
-    if ((i >= 4) && (i % 2 == 0)) {
-      data[j / 8] <<= 1;
-      if (count > 50) { // Fine-tuning of timing
-        data[j / 8] |= 1;
-      }
-      j++;
-    }
+typedef enum {
+  DHT_PHASE_IDLE,
+  DHT_PHASE_START,
+  DHT_PHASE_CAPTURE,
+} DhtPhase;
+
+static struct {
+  uint pin;
+  DhtPhase phase;
+  alarm_id_t alarm;
+  uint32_t edges[DHT_EDGES];
+  volatile uint8_t edge_count;
+  dht_cache cache;
+} dht;
+
+// Timestamps falling edges only: the bit value is in the spacing between them
+static void dht_edge_irq(void) {
+  if (gpio_get_irq_event_mask(dht.pin) & GPIO_IRQ_EDGE_FALL) {
+    gpio_acknowledge_irq(dht.pin, GPIO_IRQ_EDGE_FALL);
+    if (dht.edge_count < DHT_EDGES) dht.edges[dht.edge_count++] = time_us_32();
   }
+}
+
+// The sensor already sends tenths: humidity and temperature are 16-bit values, sign in bit 15
+bool dht_parse(const uint8_t data[5], dht_reading *reading) {
+  if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) return false;
 
-  // Data validation
-  if ((j >= 40) && (data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF))) {
-    result->humidity = (float)((data[0] << 8) + data[1]) / 10;
-    if (result->humidity > 100) {
-      result->humidity = data[0];
+  int humidity = (data[0] << 8) + data[1];
+  if (humidity > 1000) {
+    humidity = data[0] * 10;
+  }
+  int temp = ((data[2] & 0x7F) << 8) + data[3];
+  if (temp > 1250) {
+    temp = data[2] * 10;
+  }
+  if (data[2] & 0x80) {
+    temp = -temp;
+  }
+  reading->humidity_x10 = (int16_t)humidity;
+  reading->temp_x10 = (int16_t)temp;
+  return true;
+}
+
+// Decodes the captured frame into the cache; a bad frame keeps the last good reading
+static void dht_decode(void) {
+  uint8_t data[5] = {0, 0, 0, 0, 0};
+  bool complete = dht.edge_count == DHT_EDGES;
+
+  if (complete) {
+    for (int bit = 0; bit < 40; bit++) {
+      uint32_t gap = dht.edges[bit + 2] - dht.edges[bit + 1];
+      data[bit / 8] = (uint8_t)((data[bit / 8] << 1) | (gap > DHT_ONE_US));
     }
-    result->temp_celsius = (float)(((data[2] & 0x7F) << 8) + data[3]) / 10;
-    if (result->temp_celsius > 125) {
-      result->temp_celsius = data[2];
+  }
+
+  if (complete && dht_parse(data, &dht.cache.reading)) {
+    dht.cache.timestamp = get_absolute_time();
+    dht.cache.valid = true;
+  } else {
+    dht.cache.errors++;
+    if (dht.cache.valid && absolute_time_diff_us(dht.cache.timestamp, get_absolute_time()) >= DHT_STALE_US) {
+      dht.cache.valid = false;
     }
-    if (data[2] & 0x80) {
-      result->temp_celsius = -result->temp_celsius;
+  }
+}
+
+// The start pulse and capture window are minimums, so they count from when the callback returns;
+// the sampling period counts from the previous deadline (negative return) so it does not drift
+static int64_t dht_alarm(alarm_id_t id, void *user_data) {
+  switch (dht.phase) {
+    case DHT_PHASE_IDLE:
+      gpio_put(dht.pin, 0);
+      gpio_set_dir(dht.pin, GPIO_OUT);
+      dht.phase = DHT_PHASE_START;
+      return DHT_START_US;
+
+    case DHT_PHASE_START:
+      dht.edge_count = 0;
+      gpio_set_dir(dht.pin, GPIO_IN);
+      gpio_set_irq_enabled(dht.pin, GPIO_IRQ_EDGE_FALL, true);
+      dht.phase = DHT_PHASE_CAPTURE;
+      return DHT_CAPTURE_US;
+
+    case DHT_PHASE_CAPTURE:
+    default: {
+      gpio_set_irq_enabled(dht.pin, GPIO_IRQ_EDGE_FALL, false);
+      uint32_t decode_start = profile_now();
+      uint32_t errors = dht.cache.errors;
+      dht_decode();
+      profile_span_end(PROFILE_SPAN_DHT_DECODE, dht.cache.errors == errors, decode_start);
+      dht.phase = DHT_PHASE_IDLE;
+      return -((int64_t)DHT_PERIOD_MS * 1000 - DHT_START_US - DHT_CAPTURE_US);
     }
-  } else {
-    printf("Invalid DHT22 data\n");
-    result->humidity = -1; // Error value
-    result->temp_celsius = -1; // Error value
   }
 }
 
-float convert_to_fahrenheit(float temp_celsius) {
-  return (temp_celsius * 9 / 5) + 32;
+// Starts background sampling every DHT_PERIOD_MS; the first reading is ready ~10 ms later
+void dht_start_sampling(const uint DHT_PIN) {
+  dht.pin = DHT_PIN;
+  dht.phase = DHT_PHASE_IDLE;
+  gpio_init(DHT_PIN);
+  gpio_pull_up(DHT_PIN);
+  gpio_add_raw_irq_handler(DHT_PIN, dht_edge_irq);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+  dht.alarm = add_alarm_in_us(0, dht_alarm, NULL, true);
+}
+
+// Copies the latest reading; the alarm may update it at any time
+dht_cache dht_get_cached() {
+  uint32_t irq = save_and_disable_interrupts();
+  dht_cache copy = dht.cache;
+  restore_interrupts(irq);
+  return copy;
+}
+
+// ---------------------------------- Background Sampling ---------------------------------- //
+// Stops the DHT22 alarm and the ADC while the machine idles (power.h); a frame in
+// flight is dropped and the line released
+void sensors_pause() {
+  cancel_alarm(dht.alarm);
+  gpio_set_irq_enabled(dht.pin, GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_dir(dht.pin, GPIO_IN);
+  dht.phase = DHT_PHASE_IDLE;
+  adc_run(false);
+}
+
+// The first DHT22 reading after a pause is ready ~10 ms later
+void sensors_resume() {
+  adc_run(true);
+  dht.alarm = add_alarm_in_us(0, dht_alarm, NULL, true);
+}
+
+int16_t convert_to_fahrenheit(int16_t temp_x10) {
+  int32_t scaled = temp_x10 * 9;
+  return (int16_t)((scaled + (scaled < 0 ? -2 : 2)) / 5 + 320);
 }
 
 bool is_valid_reading(const dht_reading *reading) {
-  return reading->humidity > 0 && reading->temp_celsius > -40 && reading->temp_celsius < 125;
+  return reading->humidity_x10 > 0 && reading->temp_x10 > -400 && reading->temp_x10 < 1250;
 }
 
 void print_dht_reading(const dht_reading *reading) {
   if (is_valid_reading(reading)) {
-    float fahrenheit = convert_to_fahrenheit(reading->temp_celsius);
-    printf("Humidity: %.1f%%, Temperature: %.1f°C (%.1f°F)\n",
-           reading->humidity, reading->temp_celsius, fahrenheit);
+    char line[64];
+    char *p = fmt_text(line, "Humidity: ");
+    p = fmt_decimal(p, reading->humidity_x10, 1, 1);
+    p = fmt_text(p, "%, Temperature: ");
+    p = fmt_decimal(p, reading->temp_x10, 1, 1);
+    p = fmt_text(p, "°C (");
+    p = fmt_decimal(p, convert_to_fahrenheit(reading->temp_x10), 1, 1);
+    p = fmt_text(p, "°F)");
+    fmt_end(p);
+    puts(line);
   } else {
     printf("DHT22 reading error. Try again.\n");
   }
 }
 
 // ---------------------------------- RTC (Real-Time Clock) ---------------------------------- //
-// Function to read RTC data
-void rtc_read(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *rtc_data) {
-  // Configures the I2C pins for the RTC
-  gpio_set_function(sda_pin, GPIO_FUNC_I2C);
-  gpio_set_function(scl_pin, GPIO_FUNC_I2C);
-  gpio_pull_up(sda_pin);
-  gpio_pull_up(scl_pin);
-
-  // Reads RTC data
-  uint8_t reg = 0x00;
-  int ret = i2c_write_blocking(i2c, RTC_ADDR, &reg, 1, true);
-  if (ret < 0) {
-    printf("Error writing to RTC\n");
-    return;
-  }
-  ret = i2c_read_blocking(i2c, RTC_ADDR, rtc_data, 7, false);
+// Function to read RTC data (7 BCD registers starting at 0x00)
+// The shared bus is configured once by i2c_bus_init(); returns false if the RTC does not answer
+bool rtc_read(uint8_t *rtc_data) {
+  uint32_t start = profile_now();
+  int ret = i2c_bus_read_register(I2C_DEVICE_RTC, 0x00, rtc_data, 7);
+  profile_span_end(PROFILE_SPAN_RTC_READ, ret >= 0, start);
   if (ret < 0) {
     printf("Error reading from RTC\n");
-    return;
+    return false;
   }
+  return true;
+}
+
+// Control register: SQWE with RS1:RS0 = 00 drives a 1 Hz square wave on SQW/OUT (open drain);
+// otherwise OUT = 1 releases the pin, so no current flows through its pull-up
+bool rtc_set_square_wave(bool enabled) {
+  uint8_t control[2] = {0x07, enabled ? 0x10 : 0x80};
+  return i2c_bus_write(I2C_DEVICE_RTC, control, sizeof(control)) >= 0;
 }
 
 // Function to format RTC data
@@ -178,18 +347,22 @@ void format_time(uint8_t *rtc_data, char *time_buffer, char *date_buffer) {
   uint8_t month = (rtc_data[5] & 0x0F) + ((rtc_data[5] >> 4) * 10);
   uint16_t year = 2000 + (rtc_data[6] & 0x0F) + ((rtc_data[6] >> 4) * 10);
 
-  snprintf(time_buffer, 64, "%02d:%02d", hours, minutes);
-  snprintf(date_buffer, 64, "%02d %s %04d", date, months[month - 1], year);
+  fmt_end(fmt_time(time_buffer, hours, minutes));
+  char *p = fmt_uint(date_buffer, date, 2, '0');
+  *p++ = ' ';
+  p = fmt_text(p, months[month - 1]);
+  *p++ = ' ';
+  fmt_end(fmt_uint(p, year, 4, '0'));
 }
 
-// Function to get the current date from the RTC
-void get_current_date(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *day, uint8_t *month, uint8_t *year) {
-  uint8_t rtc_data[7];
-  rtc_read(i2c, sda_pin, scl_pin, rtc_data);
+// Function to get the current date from the software clock (year counted from 2000)
+void get_current_date(uint8_t *day, uint8_t *month, uint8_t *year) {
+  DateTime now = {2000, 1, 1, 0, 0, 0, 0};
+  time_now(&now);
 
-  *day = (rtc_data[4] & 0x0F) + ((rtc_data[4] >> 4) * 10);
-  *month = (rtc_data[5] & 0x0F) + ((rtc_data[5] >> 4) * 10);
-  *year = (rtc_data[6] & 0x0F) + ((rtc_data[6] >> 4) * 10);
+  *day = now.day;
+  *month = now.month;
+  *year = now.year - 2000;
 }
 
 // Function to increment the date
@@ -215,202 +388,285 @@ void increment_date(uint8_t *day, uint8_t *month, uint8_t *year) {
   }
 }
 
-void configure_day(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *day, uint8_t *month, uint8_t *year, const char *key) {
-  uint8_t current_day, current_month, current_year;
-  get_current_date(i2c, sda_pin, scl_pin, &current_day, &current_month, &current_year);
+// ---------------------------------- Schedule Editor ---------------------------------- //
+/* The scheduling screens run on the main loop like the brew pipeline: keys arrive through
+   schedule_edit_key(), and every message hold or input timeout is a deadline woken by
+   EVENT_SCREEN_TIMEOUT, so the clock, sensors, idle timer and scheduler keep running.
+   A key pressed while a confirmation is on screen ends it and goes to the next field. */
+#define SCHEDULE_INPUT_MS 30000 // A field left untouched: the day defaults to today, a digit fails the time
+#define SCHEDULE_RETRY_MS 30000 // "PRESS PLAY TO RESET" gives up and returns to the initial screen
+
+static struct {
+  TimeConfigState step;
+  ScheduledTime time;
+  uint8_t cups;
+  absolute_time_t due; // Of the current hold or input timeout
+} edit;
+
+static void edit_wait(uint32_t ms) {
+  edit.due = make_timeout_time_ms(ms);
+  event_schedule(EVENT_SCREEN_TIMEOUT, edit.due);
+}
 
-  lcd_clear();
-  lcd_set_cursor(0, 0);
-  lcd_print("SCHEDULE FOR:");
-  lcd_set_cursor(2, 0);
-  lcd_print("+ : TOMORROW");
-  lcd_set_cursor(3, 0);
-  lcd_print("- : TODAY");
-
-  uint32_t start_time = to_ms_since_boot(get_absolute_time());
-
-  while (to_ms_since_boot(get_absolute_time()) - start_time < 30000) { // 30 seconds timeout
-    if (strcmp(key, "+") == 0) {
-      increment_date(&current_day, &current_month, &current_year); // Increment to tomorrow
-      *day = current_day;
-      *month = current_month;
+static void print_digit(uint8_t row, uint8_t col, uint8_t digit) {
+  char buffer[2] = {digit + '0', '\0'};
+  lcd_set_cursor(row, col);
+  lcd_print(buffer);
+}
+
+// Draws the screen of a step and arms its deadline
+static void edit_enter(TimeConfigState step) {
+  edit.step = step;
+  switch (step) {
+    case STATE_CONFIG_DAY: {
+      uint8_t year;
+      get_current_date(&edit.time.day, &edit.time.month, &year);
+      edit.time.year = 2000 + year;
+      edit.time.weekdays = SCHEDULE_ONCE;
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("SCHEDULE FOR:");
+      lcd_set_cursor(1, 0);
+      lcd_print("> : WEEKDAYS");
+      lcd_set_cursor(2, 0);
+      lcd_print("+ : TOMORROW");
+      lcd_set_cursor(3, 0);
+      lcd_print("- : TODAY");
+      lcd_end_frame();
+      edit_wait(SCHEDULE_INPUT_MS);
+      break;
+    }
+
+    case STATE_DAY_CONFIRMED:
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("DATE CONFIRMED!");
+      lcd_end_frame();
+      edit_wait(1000);
       break;
-    } else if (strcmp(key, "-") == 0) {
-      *day = current_day;  // Keeps the current day
-      *month = current_month;
+
+    case STATE_CONFIG_HOUR:
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("SET HOURS:");
+      lcd_set_cursor(2, 2);
+      lcd_print(":");
+      lcd_end_frame();
+      edit_wait(SCHEDULE_INPUT_MS);
+      break;
+
+    case STATE_HOUR_CONFIRMED:
+      lcd_set_cursor(0, 0);
+      lcd_print("HOURS OK!         ");
+      edit_wait(2000);
+      break;
+
+    case STATE_CONFIG_MINUTES:
+      lcd_set_cursor(0, 0);
+      lcd_print("SET MINUTES:");
+      edit_wait(SCHEDULE_INPUT_MS);
+      break;
+
+    case STATE_MINUTES_CONFIRMED:
+      lcd_set_cursor(0, 0);
+      lcd_print("MIN CONFIRMED!");
+      edit_wait(1000);
+      break;
+
+    case STATE_VALIDATION: {
+      DateTime when = {edit.time.year, edit.time.month, edit.time.day, edit.time.hour, edit.time.minutes, 0, 0};
+      // Check if the scheduled time is in the future (a recurring time always has a next run)
+      if (edit.time.hour < 24 && edit.time.minutes < 60 &&
+          (edit.time.weekdays != SCHEDULE_ONCE || datetime_to_epoch_minutes(&when) > time_epoch_minutes())) {
+        edit.time.valid_time = true;
+        edit_enter(STATE_COMPLETED);
+      } else {
+        edit_enter(STATE_INVALID);
+      }
       break;
     }
-  }
 
-  lcd_clear();
-  lcd_set_cursor(0, 0);
-  lcd_print("DATE CONFIRMED!");
-  sleep_ms(1000);
+    case STATE_COMPLETED: {
+      char buffer[32];
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("COFFEE SCHEDULED!");
+      if (edit.time.weekdays == SCHEDULE_WEEKDAYS) {
+        fmt_end(fmt_text(buffer, "MON-FRI"));
+      } else {
+        fmt_end(fmt_date(buffer, edit.time.day, edit.time.month));
+      }
+      lcd_set_cursor(2, 0);
+      lcd_print("DATE: ");
+      lcd_set_cursor(2, 6);
+      lcd_print(buffer);
+      fmt_end(fmt_time(buffer, edit.time.hour, edit.time.minutes));
+      lcd_set_cursor(3, 0);
+      lcd_print("TIME: ");
+      lcd_set_cursor(3, 6);
+      lcd_print(buffer);
+      lcd_end_frame();
+      edit_wait(3000);
+      break;
+    }
+
+    case STATE_SCHEDULE_FULL:
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("SCHEDULE FULL!");
+      lcd_end_frame();
+      edit_wait(2000);
+      break;
+
+    case STATE_INVALID:
+      lcd_begin_frame();
+      lcd_clear();
+      lcd_set_cursor(0, 0);
+      lcd_print("Invalid Date/Time!");
+      lcd_set_cursor(2, 0);
+      lcd_print("PRESS PLAY TO RESET:");
+      lcd_end_frame();
+      edit_wait(SCHEDULE_RETRY_MS);
+      break;
+
+    default: // Digit fields draw as they are typed
+      edit_wait(SCHEDULE_INPUT_MS);
+      break;
+  }
 }
 
-uint8_t read_digit(const char *key, uint32_t timeout_ms) {
-  uint32_t start_time = to_ms_since_boot(get_absolute_time());
-  uint8_t digit = 0xFF; // Invalid value by default
+// Hands the confirmed time to the scheduler with the selected number of cups
+static bool edit_add_job() {
+  if (edit.time.weekdays != SCHEDULE_ONCE) {
+    return scheduler_add_recurring(edit.time.weekdays, edit.time.hour, edit.time.minutes, edit.cups);
+  }
+  DateTime when = {edit.time.year, edit.time.month, edit.time.day, edit.time.hour, edit.time.minutes, 0, 0};
+  return scheduler_add(datetime_to_epoch_minutes(&when), edit.cups);
+}
 
-  while (to_ms_since_boot(get_absolute_time()) - start_time < timeout_ms) {
-    if (strlen(key) == 1 && isdigit(key[0])) {
-      digit = key[0] - '0'; // Converts the character to a number
+// The deadline of the current step passed
+static void edit_timeout() {
+  switch (edit.step) {
+    case STATE_CONFIG_DAY:        edit_enter(STATE_DAY_CONFIRMED); break; // Keeps today
+    case STATE_DAY_CONFIRMED:     edit_enter(STATE_CONFIG_HOUR); break;
+    case STATE_HOUR_CONFIRMED:    edit_enter(STATE_CONFIG_MINUTES); break;
+    case STATE_MINUTES_CONFIRMED: edit_enter(STATE_VALIDATION); break;
+    case STATE_COMPLETED:
+      if (edit_add_job()) {
+        edit.step = STATE_FINISHED;
+      } else {
+        edit_enter(STATE_SCHEDULE_FULL);
+      }
+      break;
+    case STATE_CONFIG_HOUR:
+    case STATE_CONFIG_HOUR_UNITS:
+      edit.time.hour = 0xFF; // No digit: the time cannot be valid
+      edit_enter(STATE_VALIDATION);
+      break;
+    case STATE_CONFIG_MINUTES:
+    case STATE_CONFIG_MINUTES_UNITS:
+      edit.time.minutes = 0xFF;
+      edit_enter(STATE_VALIDATION);
+      break;
+    default: // "SCHEDULE FULL!" shown, or nobody pressed PLAY to retry
+      edit.step = STATE_FINISHED;
       break;
-    }
   }
-  sleep_ms(100);
-  return digit;
 }
 
-void configure_hour(uint8_t *hour, const char *key) {
-  uint8_t first_digit, second_digit;
-  lcd_clear();
-  lcd_set_cursor(0, 0);
-  lcd_print("SET HOURS:");
-  lcd_set_cursor(2, 2);
-  lcd_print(":");
-
-  first_digit = read_digit(key, 30000); // 30-second timeout
-  if (first_digit > 2) first_digit = 0;
-  lcd_set_cursor(2, 0);
-  char buffer[2] = {first_digit + '0', '\0'};
-  lcd_print(buffer);
-  sleep_ms(1000);
+// Starts the scheduling screens for a brew of `cups`; the main loop then calls schedule_edit_poll()
+void schedule_edit_start(uint8_t cups) {
+  memset(&edit.time, 0, sizeof(edit.time));
+  edit.cups = cups;
+  edit_enter(STATE_CONFIG_DAY);
+}
 
-  second_digit = read_digit(key, 30000);
-  if (first_digit == 2 && second_digit > 3) second_digit = 0;
-  lcd_set_cursor(2, 1);
-  char buffer1[2] = {second_digit + '0', '\0'};
-  lcd_print(buffer1);
-  sleep_ms(2000);
+// Called for every key press while the scheduling screens are up
+void schedule_edit_key(Key key) {
+  // A confirmation on screen ends early and the key goes to the next field
+  if (edit.step == STATE_DAY_CONFIRMED || edit.step == STATE_HOUR_CONFIRMED || edit.step == STATE_MINUTES_CONFIRMED) {
+    edit_timeout();
+  }
 
-  *hour = (first_digit * 10) + second_digit;
+  switch (edit.step) {
+    case STATE_CONFIG_DAY:
+      if (key == KEY_PLUS) {
+        uint8_t year = edit.time.year - 2000;
+        increment_date(&edit.time.day, &edit.time.month, &year); // Tomorrow
+        edit.time.year = 2000 + year;
+      } else if (key == KEY_NEXT) {
+        edit.time.weekdays = SCHEDULE_WEEKDAYS; // Monday to Friday, every week
+      } else if (key != KEY_MINUS) {
+        break; // MINUS keeps today
+      }
+      edit_enter(STATE_DAY_CONFIRMED);
+      break;
 
-  lcd_set_cursor(0, 0);
-  lcd_print("HOURS OK!         ");
-  sleep_ms(2000);
-}
+    case STATE_CONFIG_HOUR:
+      if (!key_is_digit(key)) break;
+      edit.time.hour = key_digit(key) > 2 ? 0 : key_digit(key);
+      print_digit(2, 0, edit.time.hour);
+      edit.time.hour *= 10;
+      edit_enter(STATE_CONFIG_HOUR_UNITS);
+      break;
 
-void configure_minutes(uint8_t *minutes, const char *key) {
-  uint8_t first_digit, second_digit;
-  lcd_set_cursor(0, 0);
-  lcd_print("SET MINUTES:");
+    case STATE_CONFIG_HOUR_UNITS: {
+      if (!key_is_digit(key)) break;
+      uint8_t digit = (edit.time.hour == 20 && key_digit(key) > 3) ? 0 : key_digit(key);
+      print_digit(2, 1, digit);
+      edit.time.hour += digit;
+      edit_enter(STATE_HOUR_CONFIRMED);
+      break;
+    }
 
-  sleep_ms(1500);
-  first_digit = read_digit(key, 30000);
-  if (first_digit > 5) first_digit = 0;
-  lcd_set_cursor(2, 3);
-  char buffer[2] = {first_digit + '0', '\0'};
-  lcd_print(buffer);
-  sleep_ms(1000);
+    case STATE_CONFIG_MINUTES:
+      if (!key_is_digit(key)) break;
+      edit.time.minutes = key_digit(key) > 5 ? 0 : key_digit(key);
+      print_digit(2, 3, edit.time.minutes);
+      edit.time.minutes *= 10;
+      edit_enter(STATE_CONFIG_MINUTES_UNITS);
+      break;
 
-  second_digit = read_digit(key, 30000);
-  lcd_set_cursor(2, 4);
-  char buffer1[2] = {second_digit + '0', '\0'};
-  lcd_print(buffer1);
-  sleep_ms(2000);
+    case STATE_CONFIG_MINUTES_UNITS:
+      if (!key_is_digit(key)) break;
+      print_digit(2, 4, key_digit(key));
+      edit.time.minutes += key_digit(key);
+      edit_enter(STATE_MINUTES_CONFIRMED);
+      break;
 
-  *minutes = first_digit * 10 + second_digit;
+    case STATE_INVALID:
+      if (key == KEY_PLAY) schedule_edit_start(edit.cups); // Restart the configuration
+      break;
 
-  lcd_clear();
-  lcd_print("MIN CONFIRMED!");
-  sleep_ms(1000);
-}
-// Function declaration for scheduled time
-ScheduledTime configure_schedule(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, const char *key) {
-  ScheduledTime scheduled_time = {0, 0, 0, 0, false};  // Inicializa a estrutura corretamente
-  TimeConfigState current_state = STATE_CONFIG_DAY;
-
-  while (true) {
-    switch (current_state) {
-      case STATE_CONFIG_DAY: {
-          uint8_t year;
-          configure_day(i2c, sda_pin, scl_pin, &scheduled_time.day, &scheduled_time.month, &year, key);
-          current_state = STATE_CONFIG_HOUR;
-          break;
-        }
-
-      case STATE_CONFIG_HOUR:
-        configure_hour(&scheduled_time.hour, key);
-        current_state = STATE_CONFIG_MINUTES;
-        break;
-
-      case STATE_CONFIG_MINUTES:
-        configure_minutes(&scheduled_time.minutes, key);
-        current_state = STATE_VALIDATION;
-        break;
-
-      case STATE_VALIDATION: {
-          uint8_t rtc_data[7];
-          rtc_read(i2c, sda_pin, scl_pin, rtc_data);
-
-          uint8_t current_day = (rtc_data[4] & 0x0F) + ((rtc_data[4] >> 4) * 10);
-          uint8_t current_month = (rtc_data[5] & 0x0F) + ((rtc_data[5] >> 4) * 10);
-          uint8_t current_hour = (rtc_data[2] & 0x0F) + ((rtc_data[2] >> 4) * 10);
-          uint8_t current_minute = (rtc_data[1] & 0x0F) + ((rtc_data[1] >> 4) * 10);
-
-          // Check if the scheduled time is in the future
-          if (scheduled_time.month > current_month ||
-              (scheduled_time.month == current_month && scheduled_time.day > current_day) ||
-              (scheduled_time.month == current_month && scheduled_time.day == current_day &&
-               (scheduled_time.hour > current_hour ||
-                (scheduled_time.hour == current_hour && scheduled_time.minutes > current_minute)))) {
-            scheduled_time.valid_time = true;
-            current_state = STATE_COMPLETED;
-          } else {
-            lcd_clear();
-            lcd_set_cursor(0, 0);
-            lcd_print("Invalid Date/Time!");
-            lcd_set_cursor(2, 0);
-            lcd_print("PRESS PLAY TO RESET:");
-            sleep_ms(3000);
-            current_state = STATE_INVALID;
-          }
-          break;
-        }
-
-      case STATE_COMPLETED:
-        lcd_clear();
-        char buffer[32];
-        lcd_set_cursor(0, 0);
-        lcd_print("COFFEE SCHEDULED!");
-        snprintf(buffer, sizeof(buffer), "%02d/%02d", scheduled_time.day, scheduled_time.month);
-        lcd_set_cursor(2, 0);
-        lcd_print("DATE: ");
-        lcd_set_cursor(2, 6);
-        lcd_print(buffer);
-        snprintf(buffer, sizeof(buffer), "%02d:%02d", scheduled_time.hour, scheduled_time.minutes);
-        lcd_set_cursor(3, 0);
-        lcd_print("TIME: ");
-        lcd_set_cursor(3, 6);
-        lcd_print(buffer);
-        sleep_ms(3000);
-        return scheduled_time;
-
-      case STATE_INVALID:
-        if (strcmp(key, "PLAY") == 0) {
-          current_state = STATE_CONFIG_DAY;  // Restart the configuration
-        }
-        break;
-
-      default:
-        break;
-    }
+    default: // The final messages stay their full time
+      break;
   }
 }
 
+// Advances on every wake-up; returns true while the scheduling screens are still up
+bool schedule_edit_poll() {
+  if (edit.step != STATE_FINISHED && time_reached(edit.due)) edit_timeout();
+  return edit.step != STATE_FINISHED;
+}
+
 // ---------------------------------- Resource Verification ---------------------------------- //
 // Function to check the amount of water and coffee beans in the machine
 // Verifies if there are enough resources for the selected number of cups.
-// If resources are insufficient, alerts the user to refill.
-void check_simulated_resources(int cups, int water_per_cup) {
-  float required_beans = cups * 10; // 10g per cup
-  float required_water = cups * water_per_cup; // Considers the chosen water quantity
+// If resources are insufficient, alerts the user to refill and returns true;
+// the caller then waits for PLAY and calls refill_simulated_resources().
+bool check_simulated_resources(int cups, int water_per_cup) {
+  int required_beans = cups * 10; // 10g per cup
+  int required_water = cups * water_per_cup; // Considers the chosen water quantity
   bool needs_refill = false;
 
   if (water_ml < required_water) { // Checks if there is enough water
     gpio_put(RED_LED, 1); // Turns on the red LED
-    play_beep_pattern(BUZZER_PIN, 400, 400, 300, 4, 0.8); // Alert sound
+    play_refill_alert(BUZZER_PIN); // Alert sound
     lcd_clear();
     blink_text("REFILL MACHINE!", 0, 2, 3, 500);
     lcd_set_cursor(2, 0);
@@ -420,7 +676,7 @@ void check_simulated_resources(int cups, int water_per_cup) {
 
   if (coffee_beans_g < required_beans) { // Checks if there are enough coffee beans
     gpio_put(RED_LED, 1); // Turns on the red LED
-    play_beep_pattern(BUZZER_PIN, 400, 400, 300, 4, 0.8); // Alert sound
+    play_refill_alert(BUZZER_PIN); // Alert sound
     lcd_clear();
     blink_text("REFILL MACHINE!", 0, 2, 3, 500);
     lcd_set_cursor(2, 0);
@@ -428,22 +684,20 @@ void check_simulated_resources(int cups, int water_per_cup) {
     needs_refill = true;
   }
 
-  if (needs_refill) {
-    while (!play_pressed) { // Waits for the user to press PLAY
-      sleep_ms(200); // Waiting loop
-    }
+  return needs_refill;
+}
 
-    // Simulates refilling beans and water
-    coffee_beans_g = 250.0; // Beans refilled
-    water_ml = 1000.0;      // Water refilled
-    gpio_put(RED_LED, 0);   // Turns off the red LED
+// Simulates refilling beans and water once the user pressed PLAY
+void refill_simulated_resources() {
+  coffee_beans_g = 250; // Beans refilled
+  water_ml = 1000;      // Water refilled
+  gpio_put(RED_LED, 0);   // Turns off the red LED
 
-    // Signals that the machine is ready again
-    lcd_clear();
-    lcd_set_cursor(1, 4);
-    lcd_print("READY AGAIN!");
-    play_success_tone(BUZZER_PIN); // Sound indicating the machine has been refilled
-    sleep_ms(2000);
-    play_pressed = false; // Resets the flag
-  }
+  // Signals that the machine is ready again
+  lcd_begin_frame();
+  lcd_clear();
+  lcd_set_cursor(1, 4);
+  lcd_print("READY AGAIN!");
+  lcd_end_frame();
+  play_success_tone(BUZZER_PIN); // Sound indicating the machine has been refilled
 }
\ No newline at end of file
@@ -7,7 +7,6 @@
 #include "pico/stdlib.h"
 #include "hardware/adc.h"
 #include "hardware/gpio.h"
-#include "hardware/i2c.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -16,17 +15,22 @@
 #include "ir_control.h"
 #include "lcd_i2c.h"
 
-// RTC address
-#define RTC_ADDR 0x68
-
 // Types and structures
 
-// Structure to store temperature and humidity readings
+// Structure to store temperature and humidity readings (fixed point, tenths)
 typedef struct {
-  float humidity;
-  float temp_celsius;
+  int16_t humidity_x10; // 0.1 %RH
+  int16_t temp_x10;     // 0.1 °C
 } dht_reading;
 
+// Latest background DHT22 sample
+typedef struct {
+  dht_reading reading;
+  absolute_time_t timestamp; // When the reading was captured
+  bool valid;                // False until the first good frame, or once the reading goes stale
+  uint32_t errors;           // Frames lost to timeouts or bad checksums
+} dht_cache;
+
 // Structure to store the configured time
 typedef struct {
   uint8_t day;
@@ -34,34 +38,43 @@ typedef struct {
   uint8_t hour;
   uint8_t minutes;
   bool valid_time; // Indicates whether the configured time is valid
+  uint16_t year;
+  uint8_t weekdays; // Recurrence mask (scheduler.h); SCHEDULE_ONCE for a single date
 } ScheduledTime;
 
 // Functions for ADC sensors (Potentiometers)
-void init_adc();
+void init_adc();                  // Starts free-running, DMA-fed sampling of ADC0..ADC2
+uint16_t adc_get_average(uint input); // Latest oversampled 12-bit value of an input
 int read_intensity();             // Reads coffee intensity (0 to 100%)
-float read_desired_temperature(); // Reads the desired temperature (85°C to 95°C)
+int16_t read_desired_temperature(); // Reads the desired temperature in 0.1 °C (850 to 950)
+int16_t desired_temperature_from_adc(uint16_t raw); // Maps a 12-bit reading to 850..950 (0.1 °C)
 int read_water_quantity();        // Reads the desired water quantity (50 ml to 200 ml)
 
 // Functions for the DHT22 sensor
-void read_from_dht(dht_reading *result, const uint DHT_PIN);
-float convert_to_fahrenheit(float temp_celsius);
+#define DHT_PERIOD_MS 2000 // Sampling period (the sensor allows at most 0.5 Hz)
+void dht_start_sampling(const uint DHT_PIN); // Samples in the background from a timer alarm
+dht_cache dht_get_cached();                   // Never touches the wire
+bool dht_parse(const uint8_t data[5], dht_reading *reading); // Checks and converts one 5-byte frame
+int16_t convert_to_fahrenheit(int16_t temp_x10);            // 0.1 °C to 0.1 °F, rounded
 bool is_valid_reading(const dht_reading *reading);
 void print_dht_reading(const dht_reading *reading);
+void sensors_pause();  // Stops DHT22 and ADC sampling (low-power idle)
+void sensors_resume(); // Starts them again
 
 // Functions for the DS1307 RTC
-void rtc_read(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *rtc_data);
+bool rtc_read(uint8_t *rtc_data);
+bool rtc_set_square_wave(bool enabled); // 1 Hz on SQW/OUT, or the pin released
 void format_time(uint8_t *rtc_data, char *time_buffer, char *date_buffer);
-void get_current_date(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *day, uint8_t *month, uint8_t *year);
+void get_current_date(uint8_t *day, uint8_t *month, uint8_t *year);
 void increment_date(uint8_t *day, uint8_t *month, uint8_t *year);
-void configure_day(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, uint8_t *day, uint8_t *month, uint8_t *year, const char *key);
-uint8_t read_digit(const char *key, uint32_t timeout_ms);
-void configure_hour(uint8_t *hour, const char *key);
-void configure_minutes(uint8_t *minutes, const char *key);
 
-// Function declaration for scheduled time
-ScheduledTime configure_schedule(i2c_inst_t *i2c, uint8_t sda_pin, uint8_t scl_pin, const char *key);
+// Scheduling screens (day, hours, minutes), run from the main loop without blocking it
+void schedule_edit_start(uint8_t cups); // Shows the first screen
+void schedule_edit_key(Key key);        // Feeds one key press
+bool schedule_edit_poll();              // True while the screens are up; the confirmed brew is added to the scheduler
 
 // Resource Management
-void check_simulated_resources(int cups, int water_per_cup);
+bool check_simulated_resources(int cups, int water_per_cup); // True if a refill is needed
+void refill_simulated_resources();                          // Refills after the user presses PLAY
 
 #endif // SENSORS_H
\ No newline at end of file
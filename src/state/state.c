@@ -6,54 +6,128 @@
 #include "ir_control.h"
 #include "sensors.h"
 #include "lcd_i2c.h"
+#include "event_loop.h"
+#include "time_service.h"
+#include "scheduler.h"
+#include "power.h"
+#include "flash_kv.h"
 #include <stdio.h>
 #include <stdint.h>
 
-// Pin definitions
-// Shared pins for the LCD and RTC (their addresses are defined in their respective libraries)
-#define I2C_PORT i2c0        // I2C communication for the LCD display and RTC
-#define SDA_PIN 4
-#define SCL_PIN 5
-
 // Global variables
-float water_ml = 1000.0;         // Initial reservoir of 1 liter
-float coffee_beans_g = 250.0;    // Initial reservoir of 250g of coffee beans (each cup uses 10g)
+int water_ml = 1000;         // Initial reservoir of 1 liter (ml)
+int coffee_beans_g = 250;    // Initial reservoir of 250g of coffee beans (each cup uses 10g)
 int cups = 0;                    // Number of coffee cups
 // Buffer that stores the scheduled brewing time
 uint8_t day_config, month_config, hour_config, minutes_config;
-bool play_pressed = false;       // Indicates if the PLAY button was pressed
 bool greeting_displayed = false; // Flag to display "it's coffee time" only once
 bool prepare_now = false;        // Flag to start coffee brewing immediately
-bool key_pressed = false;
-char key[16] = "";
-ScheduledTime scheduled_time = {0, 0, 0, 0, false};
 State current_state = STATE_INITIAL_SCREEN;
 // Ensures no flickering between the cup selection state and scheduling state
 State last_displayed_state = STATE_INITIAL_SCREEN;
 
+// ---------------------------------- Persistence ---------------------------------- //
+// Keys of the flash store; values are little-endian
+enum {
+  KV_WATER_ML,        // u32
+  KV_COFFEE_BEANS_G,  // u32
+  KV_SCHEDULE         // Pending jobs, KV_JOB_BYTES each: due (u32), cups, weekdays
+};
+#define KV_JOB_BYTES 6
+
+static void put_u32(uint8_t *p, uint32_t value) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Only called from the initial screen, so flash is never written during a brew;
+// an unchanged level or schedule costs no write at all
+static void save_machine_state() {
+  uint8_t value[SCHEDULER_MAX_JOBS * KV_JOB_BYTES];
+  put_u32(value, water_ml);
+  flash_kv_put(KV_WATER_ML, value, 4);
+  put_u32(value, coffee_beans_g);
+  flash_kv_put(KV_COFFEE_BEANS_G, value, 4);
+
+  brew_job jobs[SCHEDULER_MAX_JOBS];
+  uint8_t count = scheduler_list(jobs, SCHEDULER_MAX_JOBS);
+  for (uint8_t i = 0; i < count; i++) {
+    put_u32(value + i * KV_JOB_BYTES, jobs[i].due);
+    value[i * KV_JOB_BYTES + 4] = jobs[i].cups;
+    value[i * KV_JOB_BYTES + 5] = jobs[i].weekdays;
+  }
+  flash_kv_put(KV_SCHEDULE, value, count * KV_JOB_BYTES);
+  flash_kv_sync();
+}
+
+void restore_machine_state() {
+  uint8_t value[SCHEDULER_MAX_JOBS * KV_JOB_BYTES];
+  if (flash_kv_get(KV_WATER_ML, value, sizeof(value)) == 4) water_ml = get_u32(value);
+  if (flash_kv_get(KV_COFFEE_BEANS_G, value, sizeof(value)) == 4) coffee_beans_g = get_u32(value);
+
+  int len = flash_kv_get(KV_SCHEDULE, value, sizeof(value));
+  for (int i = 0; i + KV_JOB_BYTES <= len; i += KV_JOB_BYTES) {
+    scheduler_restore((brew_job) {get_u32(value + i), value[i + 4], value[i + 5]});
+  }
+}
+
+// ---------------------------------- State Machine ---------------------------------- //
 // Monitors the machine's state and calls the corresponding function based on the current state
-void manage_state() {
+// Runs once per wake-up of the main loop; nothing here polls on a fixed period
+void manage_state(uint32_t events) {
+  State entry_state = current_state;
+
+  // A due brew drops any menu left half way; one that came due while brewing waits for the end
+  brew_job job;
+  if (current_state != STATE_BREWING && scheduler_pop_due(&job)) {
+    cups = job.cups;
+    prepare_now = false;
+    current_state = STATE_BREWING;
+  }
+
   switch (current_state)
   {
     case STATE_INITIAL_SCREEN:
       if (!greeting_displayed) {
         display_initial_screen();
         greeting_displayed = true;
-        last_displayed_state = STATE_INITIAL_SCREEN;  // Ensures this state was displayed
-      } else {
-        display_clock();                              // Continuously updates the clock
-        display_temperature_humidity();               // Updates ambient conditions
+        events |= EVENT_CLOCK_MINUTE | EVENT_SENSOR_REFRESH;
+        power_activity();
+      } else if (last_displayed_state != STATE_INITIAL_SCREEN) {
+        events |= EVENT_CLOCK_MINUTE | EVENT_SENSOR_REFRESH; // Back from another screen
+        power_activity();
       }
+      last_displayed_state = STATE_INITIAL_SCREEN;  // Ensures this state was displayed
 
-      if (play_pressed) {
-        current_state = STATE_SELECT_CUPS;
-        play_pressed = false; // Resets the flag
-        last_displayed_state = STATE_INITIAL_SCREEN; // Forces an update in the next state
+      if (events & EVENT_CLOCK_MINUTE) {
+        display_clock();                 // Updates the clock and arms the next minute boundary
+        display_next_brew();             // Shows the next scheduled brew, if any
+      }
+      if (events & EVENT_SENSOR_REFRESH) {
+        display_temperature_humidity();  // Updates ambient conditions
+        event_schedule(EVENT_SENSOR_REFRESH, make_timeout_time_ms(SENSOR_REFRESH_MS));
+      }
+      save_machine_state();              // Levels after a brew, schedule after a change
+      if (events & EVENT_IDLE_TIMEOUT) {
+        flash_kv_compact_if_low();       // Any sector erase happens now rather than after the next brew
+        power_enter_idle();              // The main loop sleeps until a key or a due brew
       }
       break;
 
     case STATE_SELECT_CUPS:
+      if (events & EVENT_IDLE_TIMEOUT) {
+        display_initial_screen();
+        current_state = STATE_INITIAL_SCREEN; // Left untouched: the initial screen can go dark
+        break;
+      }
+      if (events & EVENT_SCREEN_TIMEOUT) {
+        last_displayed_state = STATE_INITIAL_SCREEN; // The "INVALID KEY" message ran out: prompts again
+      }
       if (last_displayed_state != STATE_SELECT_CUPS) {
+        lcd_begin_frame();
         lcd_clear();
         lcd_set_cursor(0, 0);
         lcd_print("HOW MANY CUPS?");
@@ -61,12 +135,19 @@ void manage_state() {
         lcd_print("- FROM 1 TO 5");
         lcd_set_cursor(3, 0);
         lcd_print("- 0 TO EXIT");
+        lcd_end_frame();
         last_displayed_state = STATE_SELECT_CUPS; // Updates the displayed state
       }
       break;
 
     case STATE_SCHEDULE_OR_NOW:
+      if (events & EVENT_IDLE_TIMEOUT) {
+        display_initial_screen();
+        current_state = STATE_INITIAL_SCREEN; // Left untouched: the initial screen can go dark
+        break;
+      }
       if (last_displayed_state != STATE_SCHEDULE_OR_NOW) {
+        lcd_begin_frame();
         lcd_clear();
         lcd_set_cursor(0, 0);
         lcd_print("START TIME:");
@@ -74,44 +155,34 @@ void manage_state() {
         lcd_print("1-NOW");
         lcd_set_cursor(3, 0);
         lcd_print("2-SCHEDULE");
+        lcd_end_frame();
         last_displayed_state = STATE_SCHEDULE_OR_NOW; // Updates the displayed state
       }
       break;
 
-    case STATE_BREWING:
-      prepare_coffee(cups);
-      break;
-
-    case STATE_SCHEDULING: // State for scheduling coffee preparation
-      scheduled_time = configure_schedule(I2C_PORT, SDA_PIN, SCL_PIN, key);
-      if (scheduled_time.valid_time) {
-        current_state = STATE_WAITING;
-      } else {
-        current_state = STATE_INITIAL_SCREEN;
+    case STATE_BREWING: // The pipeline advances on every wake-up and returns to the initial screen when done
+      if (last_displayed_state != STATE_BREWING) {
+        brew_start(cups);
+        last_displayed_state = STATE_BREWING;
       }
+      brew_poll();
       break;
 
-    case STATE_WAITING: { // State that compares the current time with the scheduled time to start brewing
-        uint8_t rtc_data[7];
-        rtc_read(I2C_PORT, SDA_PIN, SCL_PIN, rtc_data); // Reads the current time
-
-        uint8_t current_day = (rtc_data[4] & 0x0F) + ((rtc_data[4] >> 4) * 10);
-        uint8_t current_month = (rtc_data[5] & 0x0F) + ((rtc_data[5] >> 4) * 10);
-        uint8_t current_hour = (rtc_data[2] & 0x0F) + ((rtc_data[2] >> 4) * 10);
-        uint8_t current_minute = (rtc_data[1] & 0x0F) + ((rtc_data[1] >> 4) * 10);
-
-        // If the current time matches the scheduled time, start brewing
-        if (current_day == scheduled_time.day &&
-            current_month == scheduled_time.month &&
-            current_hour == scheduled_time.hour &&
-            current_minute == scheduled_time.minutes) {
-          current_state = STATE_BREWING;
-        }
-        break;
+    case STATE_SCHEDULING: // The screens advance on every wake-up; the confirmed brew goes to the scheduler
+      last_displayed_state = STATE_SCHEDULING;
+      if (!schedule_edit_poll()) {
+        display_initial_screen();
+        current_state = STATE_INITIAL_SCREEN; // The scheduler starts the brew from the initial screen
       }
+      break;
 
     default:
       current_state = STATE_INITIAL_SCREEN;
       break;
   }
+
+  // Lets the new state run without waiting for another wake source
+  if (current_state != entry_state) {
+    event_post(EVENT_STATE_CHANGE);
+  }
 }
\ No newline at end of file
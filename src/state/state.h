@@ -6,17 +6,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#define SENSOR_REFRESH_MS 2000 // Initial screen redraw of the cached DHT22 reading
+
 // Coffee machine states
 typedef enum {
   STATE_INITIAL_SCREEN,       // Displays the initial greeting, environment monitoring, resource levels, and current time
   STATE_SELECT_CUPS,          // Allows the user to select how many cups to prepare
   STATE_SCHEDULE_OR_NOW,      // User sets whether to prepare immediately or schedule for later
   STATE_BREWING,              // System starts the brewing routine, checking resources and extracting coffee
-  STATE_SCHEDULING,           // User sets a scheduled time for brewing
-  STATE_WAITING               // System waits until the current time matches the scheduled brewing time
+  STATE_SCHEDULING            // User sets a scheduled time for brewing (the scheduler then holds it)
 } State;
 
 // Function to manage states
-void manage_state(void);
+// events: wake sources (event_loop.h) that fired since the previous call
+void manage_state(uint32_t events);
+
+// Reloads the resource levels and pending brews saved in flash (call once the clock is running)
+void restore_machine_state();
 
 #endif // STATE_H
\ No newline at end of file
@@ -0,0 +1,160 @@
+// time_service.c
+// Software wall clock synced from the DS1307
+
+#include "time_service.h"
+#include "sensors.h"
+#include "pico/stdlib.h"
+
+static struct {
+  bool synced;
+  uint32_t base_epoch_s;   // RTC time at the last sync, in seconds since the epoch
+  uint64_t base_us;        // Timer value at the last sync
+  uint64_t next_sync_us;   // When the RTC is read again
+  bool sqw_locked;         // base_epoch_s was pinned to a square-wave edge
+} wall;
+
+static uint8_t from_bcd(uint8_t value) {
+  return (value & 0x0F) + ((value >> 4) * 10);
+}
+
+// Days since 2000-01-01 (valid for 2000..2099, where every fourth year is a leap year)
+static uint32_t days_from_date(uint16_t year, uint8_t month, uint8_t day) {
+  static const uint16_t days_before_month[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+  uint32_t y = year - 2000;
+  uint32_t days = y * 365 + (y + 3) / 4 + days_before_month[month - 1] + day - 1;
+  if (month > 2 && y % 4 == 0) days++;
+  return days;
+}
+
+static void date_from_days(uint32_t days, DateTime *dt) {
+  static const uint8_t days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  dt->weekday = (days + 6) % 7; // 2000-01-01 was a Saturday
+
+  uint32_t quad = days / 1461;  // Four-year blocks, each starting with a leap year
+  uint32_t rest = days % 1461;
+  uint16_t year = 2000 + quad * 4;
+  if (rest >= 366) {
+    rest -= 366;
+    year += 1 + rest / 365;
+    rest %= 365;
+  }
+
+  uint8_t month = 1;
+  while (true) {
+    uint8_t length = days_in_month[month - 1] + (month == 2 && year % 4 == 0);
+    if (rest < length) break;
+    rest -= length;
+    month++;
+  }
+  dt->year = year;
+  dt->month = month;
+  dt->day = rest + 1;
+}
+
+// A blank or halted DS1307 (CH, bit 7 of the seconds register) reads back zeros or stale fields
+static bool rtc_frame_valid(const uint8_t *rtc_data) {
+  uint8_t month = from_bcd(rtc_data[5] & 0x1F);
+  uint8_t day = from_bcd(rtc_data[4] & 0x3F);
+  return !(rtc_data[0] & 0x80) && from_bcd(rtc_data[0] & 0x7F) < 60 && from_bcd(rtc_data[1] & 0x7F) < 60 &&
+         from_bcd(rtc_data[2] & 0x3F) < 24 && day >= 1 && day <= 31 && month >= 1 && month <= 12;
+}
+
+// One 7-byte register read; extrapolation restarts from this instant
+static void time_sync() {
+  uint8_t rtc_data[7];
+  uint64_t now_us = time_us_64();
+  if (!rtc_read(rtc_data) || !rtc_frame_valid(rtc_data)) { // An invalid frame is retried like a failed read
+    wall.next_sync_us = now_us + (uint64_t)TIME_RETRY_MS * 1000;
+    return;
+  }
+
+  uint32_t days = days_from_date(2000 + from_bcd(rtc_data[6]), from_bcd(rtc_data[5] & 0x1F), from_bcd(rtc_data[4] & 0x3F));
+  wall.base_epoch_s = days * 86400 + from_bcd(rtc_data[2] & 0x3F) * 3600 +
+                       from_bcd(rtc_data[1] & 0x7F) * 60 + from_bcd(rtc_data[0] & 0x7F);
+  wall.base_us = now_us;
+  wall.next_sync_us = now_us + (uint64_t)TIME_RESYNC_MS * 1000;
+  wall.synced = true;
+  wall.sqw_locked = false;
+}
+
+// Microseconds since the epoch, resyncing first when the hourly read is due
+static bool epoch_us(uint64_t *out) {
+  if (time_us_64() >= wall.next_sync_us) time_sync();
+  if (!wall.synced) return false;
+  *out = (uint64_t)wall.base_epoch_s * 1000000 + (time_us_64() - wall.base_us);
+  return true;
+}
+
+void time_service_init() {
+  wall.synced = false;
+  wall.next_sync_us = 0;
+  time_sync();
+}
+
+void time_service_resync() {
+  time_sync();
+}
+
+// ---------------------------------- Square Wave ---------------------------------- //
+/* The DS1307 1 Hz output falls as its seconds register advances. While the timer
+   is stopped (dormant sleep) each edge moves the clock on by one second, so the
+   clock keeps counting without a bus read; the first edge rounds the extrapolated
+   time to the nearest second instead. */
+void time_service_sqw_start() {
+  wall.sqw_locked = false;
+}
+
+void time_service_sqw_edge() {
+  if (!wall.synced) return;
+  uint64_t now_us = time_us_64();
+  if (wall.sqw_locked) {
+    wall.base_epoch_s++;
+  } else {
+    uint64_t us = (uint64_t)wall.base_epoch_s * 1000000 + (now_us - wall.base_us);
+    wall.base_epoch_s = (us + 500000) / 1000000;
+    wall.sqw_locked = true;
+  }
+  wall.base_us = now_us;
+}
+
+bool time_now(DateTime *now) {
+  uint64_t us;
+  if (!epoch_us(&us)) return false;
+
+  uint32_t seconds = us / 1000000;
+  date_from_days(seconds / 86400, now);
+  seconds %= 86400;
+  now->hour = seconds / 3600;
+  now->minute = seconds / 60 % 60;
+  now->second = seconds % 60;
+  return true;
+}
+
+uint32_t time_epoch_minutes() {
+  uint64_t us;
+  if (!epoch_us(&us)) return 0;
+  return us / 60000000;
+}
+
+uint32_t time_ms_until_next_minute() {
+  uint64_t us;
+  if (!epoch_us(&us)) return TIME_RETRY_MS;
+  return (60000000 - us % 60000000) / 1000 + TIME_MINUTE_MARGIN_MS;
+}
+
+int64_t time_us_until_epoch_minute(uint32_t minutes) {
+  uint64_t us;
+  if (!epoch_us(&us)) return (int64_t)TIME_RETRY_MS * 1000;
+  return (int64_t)minutes * 60000000 - (int64_t)us;
+}
+
+uint32_t datetime_to_epoch_minutes(const DateTime *dt) {
+  return days_from_date(dt->year, dt->month, dt->day) * 1440 + dt->hour * 60 + dt->minute;
+}
+
+void datetime_from_epoch_minutes(uint32_t minutes, DateTime *dt) {
+  date_from_days(minutes / 1440, dt);
+  dt->hour = minutes % 1440 / 60;
+  dt->minute = minutes % 60;
+  dt->second = 0;
+}
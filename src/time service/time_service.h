@@ -0,0 +1,39 @@
+// time_service.h
+// Software wall clock: reads the DS1307 once at boot and once an hour, and in
+// between extrapolates from the microsecond timer, so callers never touch the bus.
+// Epoch values count from 2000-01-01 00:00:00, the start of the DS1307 range.
+
+#ifndef TIME_SERVICE_H
+#define TIME_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIME_RESYNC_MS       (60 * 60 * 1000) // Corrects the timer drift against the RTC
+#define TIME_RETRY_MS        (10 * 1000)      // Next attempt after a failed RTC read
+#define TIME_MINUTE_MARGIN_MS 5               // Wake-ups land just past the minute boundary
+
+// Decoded calendar time
+typedef struct {
+  uint16_t year;    // 2000..2099
+  uint8_t month;    // 1..12
+  uint8_t day;      // 1..31
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t weekday;  // 0 = Sunday
+} DateTime;
+
+void time_service_init();                     // Reads the RTC for the first time
+void time_service_resync();                   // Reads the RTC now, e.g. after the timer was stopped
+void time_service_sqw_start();                // The next square-wave edge pins the clock to a whole second
+void time_service_sqw_edge();                 // One falling edge of the DS1307 1 Hz output
+bool time_now(DateTime *now);                 // False until the RTC has been read once
+uint32_t time_epoch_minutes();                // Minutes since the epoch (0 if never synced)
+uint32_t time_ms_until_next_minute();         // Delay to arm a minute-boundary refresh
+int64_t time_us_until_epoch_minute(uint32_t minutes); // Negative once that minute has started
+
+uint32_t datetime_to_epoch_minutes(const DateTime *dt);
+void datetime_from_epoch_minutes(uint32_t minutes, DateTime *dt);
+
+#endif // TIME_SERVICE_H
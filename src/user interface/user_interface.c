@@ -6,30 +6,31 @@
 #include "pico/stdlib.h"
 #include <string.h>
 #include "lcd_i2c.h"
+#include "lcd_format.h"
 #include "sensors.h"
 #include "actuators.h"
 #include "ir_control.h"
+#include "internal_operations.h"
 #include "state.h"
+#include "event_loop.h"
+#include "time_service.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "power.h"
 
-#define DHT_PIN 8      // DHT22 sensor for monitoring ambient temperature and humidity
-#define I2C_PORT i2c0  
-#define SDA_PIN 4
-#define SCL_PIN 5
 #define BUZZER_PIN 14  // Buzzer for sound notifications
 
-extern float water_ml;
-extern float coffee_beans_g;
+extern int water_ml;
+extern int coffee_beans_g;
 extern State current_state;
 extern int cups;
-extern bool play_pressed;
-extern bool key_pressed;
 extern bool prepare_now;
-extern char key[16];
 
 // -------------------------------------------------------------------------------------------------- //
 // Screen and Menu Functions
 
 void ask_number_of_cups() {
+  lcd_begin_frame();
   lcd_clear();
   lcd_set_cursor(0, 0);
   lcd_print("HOW MANY CUPS?");
@@ -37,9 +38,11 @@ void ask_number_of_cups() {
   lcd_print("- FROM 1 TO 5");
   lcd_set_cursor(3, 0);
   lcd_print("- 0 TO EXIT");
+  lcd_end_frame();
 }
 
 void ask_when_to_prepare() {
+  lcd_begin_frame();
   lcd_clear();
   lcd_set_cursor(0, 0);
   lcd_print("START TIME:");
@@ -47,6 +50,7 @@ void ask_when_to_prepare() {
   lcd_print("1-NOW");
   lcd_set_cursor(3, 0);
   lcd_print("2-SCHEDULE");
+  lcd_end_frame();
 }
 
 // -------------------------------------------------------------------------------------------------- //
@@ -55,93 +59,129 @@ void ask_when_to_prepare() {
 // Displays the initial screen with updated B (beans = coffee beans) and W (water) values
 void display_initial_screen() {
   gpio_put(7, 1); // Turns on the green LED to indicate that the machine is on
-  static float last_water_ml = -1.0;
-  static float last_coffee_beans_g = -1.0;
+  static int last_water_ml = -1;
+  static int last_coffee_beans_g = -1;
 
   lcd_clear();
-  type_effect(" IT'S COFFEE TIME!", 0, 50);
-  sleep_ms(500);
+  type_effect(" IT'S COFFEE TIME!", 0, 50); // Types alongside the status row below
 
   if (water_ml != last_water_ml || coffee_beans_g != last_coffee_beans_g) {
     char status[32];
-    snprintf(status, sizeof(status), "B:%.0fg|W:%.2fL", coffee_beans_g, water_ml / 1000);
+    char *p = fmt_text(status, "B:");
+    p = fmt_int(p, coffee_beans_g);
+    p = fmt_text(p, "g|W:");
+    p = fmt_decimal(p, water_ml, 3, 2); // Litres
+    fmt_end(fmt_text(p, "L"));
     type_effect(status, 2, 100);
     last_water_ml = water_ml;
     last_coffee_beans_g = coffee_beans_g;
   }
 }
 
-// Displays updated ambient conditions on the initial screen
+// Displays the cached ambient conditions on the initial screen (sampled in the background)
+// The error tone only sounds when the sensor is first lost, not on every refresh
 void display_temperature_humidity() {
-  dht_reading reading;
-  read_from_dht(&reading, DHT_PIN);
+  static bool sensor_lost = false;
+  dht_cache cache = dht_get_cached();
 
   lcd_set_cursor(3, 0);
-  if (is_valid_reading(&reading)) {
+  if (cache.valid && is_valid_reading(&cache.reading)) {
     char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%.1fC|H:%.1f%%", reading.temp_celsius, reading.humidity);
+    char *p = fmt_decimal(buffer, cache.reading.temp_x10, 1, 1);
+    p = fmt_text(p, "C|H:");
+    p = fmt_decimal(p, cache.reading.humidity_x10, 1, 1);
+    fmt_end(fmt_text(p, "%"));
     lcd_print(buffer);
+    sensor_lost = false;
   } else {
     lcd_print("Error!");
-    play_error_tone(BUZZER_PIN);
+    if (!sensor_lost) play_error_tone(BUZZER_PIN);
+    sensor_lost = true;
   }
-  sleep_ms(300);
 }
 
-// Displays the HH:MM clock on the initial screen
+// Displays the HH:MM clock on the initial screen and arms the next refresh at the minute boundary
+// Reads the software clock, so the refresh costs no bus traffic
 void display_clock() {
-  uint8_t rtc_data[7];
+  DateTime now;
   char time_buffer[6];
-  rtc_read(I2C_PORT, SDA_PIN, SCL_PIN, rtc_data);
+  event_schedule(EVENT_CLOCK_MINUTE, make_timeout_time_ms(time_ms_until_next_minute()));
+  if (!time_now(&now)) return;
 
-  uint8_t hours = (rtc_data[2] & 0x0F) + ((rtc_data[2] >> 4) * 10);
-  uint8_t minutes = (rtc_data[1] & 0x0F) + ((rtc_data[1] >> 4) * 10);
-
-  snprintf(time_buffer, sizeof(time_buffer), "%02d:%02d", hours, minutes);
+  fmt_end(fmt_time(time_buffer, now.hour, now.minute));
   lcd_set_cursor(3, 15);
   lcd_print(time_buffer);
-  sleep_ms(300);
+}
+
+// Shows the next scheduled brew on the free row of the initial screen
+void display_next_brew() {
+  char buffer[LCD_COLS + 1];
+  brew_job job;
+
+  if (scheduler_peek(&job)) {
+    DateTime when;
+    datetime_from_epoch_minutes(job.due, &when);
+    char *p = fmt_text(buffer, "NEXT ");
+    p = fmt_date(p, when.day, when.month);
+    *p++ = ' ';
+    p = fmt_time(p, when.hour, when.minute);
+    *p++ = ' ';
+    p = fmt_uint(p, job.cups, 0, ' ');
+    fmt_end(fmt_text(p, "C"));
+  } else {
+    fmt_end(fmt_repeat(buffer, ' ', LCD_COLS));
+  }
+  lcd_set_cursor(1, 0);
+  lcd_print(buffer);
 }
 
 // -------------------------------------------------------------------------------------------------- //
-// Callback function to process IR remote control commands
+// Handles one key event from the IR queue
 // Maps remote control buttons to specific actions, such as starting preparation, setting a time, etc.
-void ir_callback(uint16_t address, uint16_t command, int type) {
-  const char* key_name = get_key_name(command);
-
-  // Checks if a valid key was pressed
-  if (strlen(key_name) > 0) {
-    key_pressed = true;
-    strncpy(key, key_name, sizeof(key));
-    key[sizeof(key) - 1] = '\0'; // Ensures null termination
+// Runs in thread context; the interrupt only queues the decoded key.
+void handle_key(const key_event *event) {
+  if (event->repeat) return; // Holding a button does not press it again
+  if (power_wake_key(event)) return; // The press that woke the screen only wakes it
+  power_activity();
+  Key key = event->key;
+  if (key == KEY_TEST) { // Service key: dumps the profile over stdio, in any state
+    profile_dump();
+    return;
   }
+  lcd_finish_animation(LCD_ALL_ROWS); // A key press skips to the end of the greeting and other effects
 
-  if (strcmp(key_name, "PLAY") == 0) {
-    play_pressed = true; // Marks that PLAY was pressed
+  if (current_state == STATE_INITIAL_SCREEN) {
+    if (key == KEY_PLAY) current_state = STATE_SELECT_CUPS;
   } else if (current_state == STATE_SELECT_CUPS) {
-    if (strcmp(key_name, "0") == 0) { // If 0 is pressed, return to the start
+    if (key == KEY_0) { // If 0 is pressed, return to the start
       lcd_clear();
       display_initial_screen();
       current_state = STATE_INITIAL_SCREEN; // Returns to the initial screen
-    } else if (strcmp(key_name, "1") == 0 || strcmp(key_name, "2") == 0 ||
-               strcmp(key_name, "3") == 0 || strcmp(key_name, "4") == 0 || strcmp(key_name, "5") == 0) {
-      cups = key_name[0] - '0'; // Converts the key into the desired number of cups
+    } else if (key >= KEY_1 && key <= KEY_5) {
+      cups = key_digit(key); // Converts the key into the desired number of cups
       current_state = STATE_SCHEDULE_OR_NOW;
-    } else {
+    } else if (key != KEY_PLAY) {
+      lcd_begin_frame();
       lcd_clear();
       lcd_set_cursor(0, 0);
       lcd_print("INVALID KEY"); // If the user presses an invalid key
       lcd_set_cursor(2, 0);
       lcd_print("PLEASE SELECT 1 TO 5");
-      sleep_ms(1000);
+      lcd_end_frame();
+      event_schedule(EVENT_SCREEN_TIMEOUT, make_timeout_time_ms(1000)); // Then the prompt comes back
     }
   } else if (current_state == STATE_SCHEDULE_OR_NOW) { // User's choice to prepare now or schedule
-    if (strcmp(key_name, "1") == 0) {
+    if (key == KEY_1) {
       prepare_now = true;
       current_state = STATE_BREWING;
-    } else if (strcmp(key_name, "2") == 0) {
+    } else if (key == KEY_2) {
       prepare_now = false;
       current_state = STATE_SCHEDULING;
+      schedule_edit_start(cups);
     }
+  } else if (current_state == STATE_SCHEDULING) {
+    schedule_edit_key(key);
+  } else if (current_state == STATE_BREWING) {
+    if (key == KEY_PLAY) brew_confirm_refill(); // Only acted on while a refill is pending
   }
 }
\ No newline at end of file
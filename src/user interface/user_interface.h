@@ -5,6 +5,7 @@
 #define USER_INTERFACE_H
 
 #include <stdint.h>  // For standard data types (uint8_t)
+#include "ir_control.h"
 
 // Interface Control Functions
 void display_initial_screen();         // Displays the initial screen with system status (water, beans, greeting)
@@ -13,9 +14,10 @@ void ask_when_to_prepare();            // Asks if the preparation should be imme
 
 // Monitoring Functions
 void display_temperature_humidity();   // Displays temperature and humidity from the DHT22 sensor
-void display_clock();                  // Displays the current time read from the RTC
+void display_clock();                  // Displays the current time from the software clock
+void display_next_brew();              // Displays the next scheduled brew (or clears the row)
 
-// Callback function to process IR remote control commands
-void ir_callback(uint16_t address, uint16_t command, int type);
+// Handles one key event from the IR queue (thread context)
+void handle_key(const key_event *event);
 
 #endif // USER_INTERFACE_H